@@ -1,5 +1,7 @@
 #pragma once
 
+#include "LinkProfile.h"
+
 #include <NimBLEDevice.h>
 
 #include <cstdint>
@@ -14,7 +16,12 @@ class BLEGUIClient {
 		BLERemoteCharacteristic* pRemoteCharacteristic = nullptr;
 
 	public:
-		BLEGUIClient(const BLEAddress& addr);
+		/**
+		 * Connects to the device.
+		 * \param profile link parameters of the connection, LinkProfile::Default uses a short interval for a fast connection.
+		 * LinkProfile::Adaptive is the same as LinkProfile::LowLatency here.
+		 */
+		BLEGUIClient(const BLEAddress& addr, LinkProfile profile = LinkProfile::Default);
 		~BLEGUIClient();
 
 		bool isConnected() const;
@@ -2,6 +2,7 @@
 
 #include "DeviceType.h"
 #include "GUIFlag.h"
+#include "LinkProfile.h"
 
 #include <RGBW.h>
 #include <ColorChannels.h>
@@ -11,12 +12,13 @@
 #include <functional>
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include <NimBLEDevice.h>
 
 namespace webgui {
-struct RootElement;
-struct AValueWrapper;
+struct IGUIModel;
+struct Value;
 }
 
 class BLELedController {
@@ -36,6 +38,11 @@ class BLELedController {
 
 		void onCharacteristicWritten(NimBLECharacteristic* pCharacteristic);
 
+		/**
+		 * Called for every write of a client, see LinkProfile::Adaptive.
+		 */
+		void onClientActivity(uint16_t conHandle);
+
 		void handleLedInfoRequest(NimBLECharacteristic& characteristic);
 		void writeLedInfoDataV1(NimBLECharacteristic& characteristic) const;
 
@@ -76,20 +83,84 @@ class BLELedController {
 		void setOnConnectCallback(std::function<void(const char*)> onConnectCallback);
 		void setOnDisconnectCallback(std::function<void(const char*)> onDisconnectCallback);
 
-		void setGUI(std::shared_ptr<webgui::RootElement> guiRoot);
+		/**
+		 * Sets the GUI which is provided to the clients, a webgui::RootElement, webgui::FlatGUI or webgui::StaticGUI.
+		 */
+		void setGUI(std::shared_ptr<webgui::IGUIModel> guiModel);
+
+		/**
+		 * \returns the numeric id of the GUI element with the absolute path (comma separated),
+		 * webgui::INVALID_ELEMENT_ID when the path is unknown or no GUI is set.
+		 * Resolve the id once for values which change often, the id based calls need no lookup.
+		 */
+		uint16_t findGUIElementId(std::string_view path) const;
 
 		/**
 		 * Sends a GUI value update to all connected clients with the current value of the field.
+		 * Elements with a publish interval (setPublishInterval()) are send periodically instead, this call does not exceed their rate.
 		 * \returns true on success, false when the path was not valid.
 		 */
 		bool notifyGUIValueChange(const std::vector<std::string>& path);
 
+		/**
+		 * Same as notifyGUIValueChange() with the path, but with the numeric element id (no lookup needed).
+		 * \returns true on success, false when the id was not valid.
+		 */
+		bool notifyGUIValueChange(uint16_t elementId);
+
+		/**
+		 * Starts a batch of value changes: The following notifyGUIValueChange() calls are collected
+		 * and send together with commitGUIValueBatch(), packed into as few notifications as possible.
+		 * Batches can be nested.
+		 */
+		void beginGUIValueBatch();
+
+		/**
+		 * Sends the latest values of all elements changed since beginGUIValueBatch().
+		 */
+		void commitGUIValueBatch();
+
 		/**
 		 * Changes a flag on a GUI element specified by the path.
 		 * Also sends a update to the clients when the value actually changed.
 		 * \returns true on success, false when the path was not valid.
 		 */
 		bool setGUIElementFlag(const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState);
+		bool setGUIElementFlag(uint16_t elementId, webgui::GUIFlag flag, bool newState);
+
+		/**
+		 * Sends GUI value and flag updates with a compact numeric element id instead of the full path.
+		 * The ids are part of the GUI description, so all clients must support the id based packets.
+		 * Disabled by default.
+		 */
+		void setGUIUseElementIds(bool enabled);
+
+		/**
+		 * Sends GUI value updates in between the chunks of larger transfers (GUI description, value snapshots),
+		 * so the controls of connected clients stay responsive while another client loads the GUI.
+		 * All clients must support the StreamChunk packet. Disabled by default, should be set before clients connect.
+		 */
+		void setGUIInterleavePackets(bool enabled);
+
+		/**
+		 * Sends the periodic values of elements with a publish interval in a compact encoding:
+		 * Without request id and length, with variable length element ids and numbers as delta to the previous value.
+		 * All clients must support the UpdateValuesCompact packet. Disabled by default.
+		 */
+		void setGUICompactTelemetry(bool enabled);
+
+		/**
+		 * Sets the link profile which is requested for new connections, see LinkProfile.
+		 * LinkProfile::Default by default, the parameters of the client are kept.
+		 */
+		void setDefaultLinkProfile(LinkProfile profile);
+
+		/**
+		 * Changes the link profile of an open connection, the client is identified by the MAC address
+		 * as given to the connect callback (setOnConnectCallback()).
+		 * \returns false when no client with the address is connected.
+		 */
+		bool setLinkProfile(const char* mac, LinkProfile profile);
 
 		[[deprecated("Not required anymore, will be removed in a future version.")]]
 		void update();
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>	// for std::memcpy()
+#include <string_view>
+#include <vector>
+
+namespace webgui {
+
+/**
+ * Element types of the binary GUI schema.
+ */
+enum class BinaryElementType : uint8_t {
+	Root = 0,
+	Group = 1,
+	Range = 2,
+	Checkbox = 3,
+	Radio = 4,
+	DropDown = 5,
+	Button = 6,
+	NumberFieldInt32 = 7,
+	TextField = 8,
+	PasswordField = 9,
+	RGBWRange = 10,
+	Compass = 11,
+};
+
+/**
+ * Bits of the flags byte in front of every element.
+ */
+enum BinaryElementFlags : uint8_t {
+	BINARY_FLAG_ADVANCED = 0x01,
+	BINARY_FLAG_READ_ONLY = 0x02,
+	BINARY_FLAG_COLLAPSABLE = 0x04,
+	BINARY_FLAG_COLLAPSED = 0x08,
+};
+
+/**
+ * Writer for the binary (TLV) GUI schema, a compact alternative to the JSON description.
+ *
+ * Element := type:u8 length:varuint payload[length]   (length padded to ELEMENT_LENGTH_SIZE bytes)
+ * payload := flags:u8 id:varuint name:string <type specific fields>
+ *
+ * Groups (and the root) contain their child elements as type specific fields.
+ * Strings are prefixed by a varuint length, all fixed size numbers are big endian.
+ * The length allows readers to skip unknown element types.
+ */
+struct BinarySchemaWriter {
+	// Element lengths are padded varuints of a fixed size, so they can be written after the payload (up to 2 MiB per element)
+	static constexpr size_t ELEMENT_LENGTH_SIZE = 3;
+
+	std::vector<uint8_t> data;
+
+	void writeUInt8(uint8_t value) {
+		data.push_back(value);
+	}
+
+	void writeUInt32(uint32_t value) {
+		data.push_back(value >> 24);
+		data.push_back(value >> 16);
+		data.push_back(value >> 8);
+		data.push_back(value);
+	}
+
+	void writeInt32(int32_t value) {
+		writeUInt32(uint32_t(value));
+	}
+
+	void writeFloat32(float value) {
+		uint32_t rawValue;
+		std::memcpy(&rawValue, &value, sizeof(rawValue));
+		writeUInt32(rawValue);
+	}
+
+	/**
+	 * Writes a unsigned LEB128 encoded value (7 bits per byte, least significant group first).
+	 */
+	void writeVarUInt(uint32_t value) {
+		while (value >= 0x80) {
+			data.push_back(uint8_t(value) | 0x80);
+			value >>= 7;
+		}
+
+		data.push_back(uint8_t(value));
+	}
+
+	void writeString(std::string_view str) {
+		writeVarUInt(str.size());
+		data.insert(data.end(), str.begin(), str.end());
+	}
+
+	/**
+	 * Writes the element head and returns the start of the payload, which must be passed to endElement().
+	 * The length is reserved as ELEMENT_LENGTH_SIZE bytes and patched by endElement().
+	 */
+	size_t beginElement(BinaryElementType type, uint8_t flags, uint16_t id, std::string_view name) {
+		writeUInt8(uint8_t(type));
+		data.resize(data.size() + ELEMENT_LENGTH_SIZE);
+		size_t payloadStart = data.size();
+
+		writeUInt8(flags);
+		writeVarUInt(id);
+		writeString(name);
+
+		return payloadStart;
+	}
+
+	/**
+	 * Writes the payload length into the space reserved in front of the payload.
+	 */
+	void endElement(size_t payloadStart) {
+		uint32_t length = data.size() - payloadStart;
+		uint8_t* target = data.data() + payloadStart - ELEMENT_LENGTH_SIZE;
+
+		for (size_t i = 0; i < ELEMENT_LENGTH_SIZE; ++i) {
+			target[i] = uint8_t(length & 0x7F);
+			length >>= 7;
+
+			if (i + 1 < ELEMENT_LENGTH_SIZE) {
+				target[i] |= 0x80;
+			}
+		}
+	}
+};
+
+}
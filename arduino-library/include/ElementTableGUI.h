@@ -0,0 +1,505 @@
+#pragma once
+
+#include "GUIElements.h"
+
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace webgui {
+
+/**
+ * Element of a flat element table, see ElementTableGUI.
+ *
+ * The tree structure is stored as indices into the table, the strings as offsets into the string pool of the table:
+ * The absolute path (comma separated, the last part is the name) and the zero terminated items (radio, drop down)
+ * or channel string (RGBW range).
+ */
+struct ElementTableRecord {
+	BinaryElementType type;
+	uint16_t maxLength;
+	uint16_t parent;		// INVALID_ELEMENT_ID for top level elements
+	uint16_t firstChild;	// INVALID_ELEMENT_ID when there are no children
+	uint16_t nextSibling;	// INVALID_ELEMENT_ID for the last element of a group
+	uint16_t nameLength;
+	uint16_t pathLength;
+	uint16_t itemCount;
+	uint32_t pathOffset;
+	uint32_t stringsOffset;
+	int32_t min;
+	int32_t max;
+};
+
+/**
+ * IGUIModel implementation on top of a flat element table, the element id is the index into the table.
+ *
+ * Walking the GUI only reads the contiguous records, there is no object per element.
+ * The Derived class provides the storage (see StaticGUI and FlatGUI):
+ *  - const ElementTableRecord& getRecord(uint16_t id) const
+ *  - const char* getPool() const
+ *  - const uint16_t* getSortedIds() const, all ids sorted by path
+ *  - uint16_t getFirstElement() const, first top level element
+ *  - void* getHandlerPointer(uint16_t id) const, type depends on the element type, see StaticGUI::bind()
+ *  - uint8_t getFlags(uint16_t id) const + void setFlags(uint16_t id, uint8_t flags), BINARY_FLAG_* values
+ *  - uint32_t getPublishInterval(uint16_t id) const, see IGUIModel::getElementPublishIntervalById()
+ */
+template <typename Derived>
+struct ElementTableGUI : public IGUIModel {
+	/**
+	 * Value slot of the generated JSON template.
+	 */
+	struct JSONValueSlot : public IJSONValueSource {
+		const ElementTableGUI* gui;
+		uint16_t id;
+
+		JSONValueSlot(const ElementTableGUI* gui, uint16_t id) :
+			gui(gui),
+			id(id) {}
+
+		virtual std::string toJSONValueField() const override {
+			return gui->toJSONValueField(id);
+		}
+	};
+
+	/**
+	 * The generated JSON template owns its value slots, nothing is kept after sending.
+	 */
+	struct JSONTemplateWithSlots : public JSONTemplate {
+		std::vector<JSONValueSlot> valueSlots;
+	};
+
+	mutable std::optional<uint32_t> structureHash;
+
+	std::function<void()> onValuesCommittedCallback;
+
+	ElementTableGUI() :
+		structureHash(),
+		onValuesCommittedCallback() {}
+
+	/**
+	 * Sets the callback invoked once after a client changed several values at once (transaction).
+	 * The data handlers of the single elements are invoked before, the callback can apply the combined state.
+	 */
+	void setOnValuesCommittedCallback(std::function<void()> callback) {
+		onValuesCommittedCallback = callback;
+	}
+
+	const Derived& derived() const {
+		return static_cast<const Derived&>(*this);
+	}
+
+	Derived& derived() {
+		return static_cast<Derived&>(*this);
+	}
+
+	template <typename HandlerType>
+	HandlerType* getHandler(uint16_t id) const {
+		return static_cast<HandlerType*>(derived().getHandlerPointer(id));
+	}
+
+	std::string_view getElementName(uint16_t id) const {
+		const ElementTableRecord& record = derived().getRecord(id);
+		return std::string_view(derived().getPool() + record.pathOffset + record.pathLength - record.nameLength, record.nameLength);
+	}
+
+	/**
+	 * \return the first zero terminated string of the items (radio, drop down) or the channel string (RGBW range).
+	 */
+	const char* getElementStrings(uint16_t id) const {
+		return derived().getPool() + derived().getRecord(id).stringsOffset;
+	}
+
+	/**
+	 * Must be called after the structure was changed.
+	 */
+	void invalidateStructureHash() {
+		structureHash.reset();
+	}
+
+	virtual uint16_t findElementId(std::string_view absolutePath) const override {
+		const uint16_t* sortedIds = derived().getSortedIds();
+		size_t first = 0;
+		size_t last = derived().getElementCount();
+
+		while (first < last) {
+			size_t middle = first + (last - first) / 2;
+
+			if (getElementPath(sortedIds[middle]) < absolutePath) {
+				first = middle + 1;
+			} else {
+				last = middle;
+			}
+		}
+
+		if (first < derived().getElementCount() && getElementPath(sortedIds[first]) == absolutePath)
+			return sortedIds[first];
+
+		return INVALID_ELEMENT_ID;
+	}
+
+	virtual std::string_view getElementPath(uint16_t id) const override {
+		if (id >= derived().getElementCount())
+			return {};
+
+		const ElementTableRecord& record = derived().getRecord(id);
+		return std::string_view(derived().getPool() + record.pathOffset, record.pathLength);
+	}
+
+	virtual std::optional<Value> getElementValueById(uint16_t id) const override {
+		if (id >= derived().getElementCount())
+			return {};
+
+		const ElementTableRecord& record = derived().getRecord(id);
+
+		if (record.type == BinaryElementType::Button)
+			return Value(false);
+
+		if (!derived().getHandlerPointer(id))
+			return {};
+
+		switch (record.type) {
+			case BinaryElementType::Range:
+			case BinaryElementType::NumberFieldInt32:
+			case BinaryElementType::Compass:
+				return WrapValue(getHandler<IInt32DataHandler>(id)->getValue());
+			case BinaryElementType::Checkbox:
+				return WrapValue(getHandler<IBoolDataHandler>(id)->getValue());
+			case BinaryElementType::Radio:
+			case BinaryElementType::DropDown:
+				return WrapValue(getHandler<IUInt16DataHandler>(id)->getValue());
+			case BinaryElementType::TextField:
+			case BinaryElementType::PasswordField:
+				return WrapValue(getHandler<IStringDataHandler>(id)->getValue());
+			case BinaryElementType::RGBWRange:
+				return WrapValue(getHandler<IRGBWDataHandler>(id)->getValue());
+			case BinaryElementType::Root:
+			case BinaryElementType::Group:
+			case BinaryElementType::Button:
+				break;
+		}
+
+		return {};
+	}
+
+	virtual bool setElementValueById(uint16_t id, const Value& newValue) override {
+		if (id >= derived().getElementCount() || !derived().getHandlerPointer(id))
+			return false;
+
+		const ElementTableRecord& record = derived().getRecord(id);
+
+		switch (record.type) {
+			case BinaryElementType::Range:
+				getHandler<IInt32DataHandler>(id)->setValue(std::clamp(newValue.getAsInt32(), record.min, record.max));
+				return true;
+			case BinaryElementType::NumberFieldInt32:
+				getHandler<IInt32DataHandler>(id)->setValue(newValue.getAsInt32());
+				return true;
+			case BinaryElementType::Compass:
+				// Compass is just an output element
+				return true;
+			case BinaryElementType::Checkbox:
+				getHandler<IBoolDataHandler>(id)->setValue(newValue.getAsBool());
+				return true;
+			case BinaryElementType::Radio:
+			case BinaryElementType::DropDown:
+				getHandler<IUInt16DataHandler>(id)->setValue(std::clamp<int16_t>(newValue.getAsInt32(), 0, record.itemCount));
+				return true;
+			case BinaryElementType::TextField:
+			case BinaryElementType::PasswordField:
+				getHandler<IStringDataHandler>(id)->setValue(newValue.getAsString());
+				return true;
+			case BinaryElementType::RGBWRange:
+				getHandler<IRGBWDataHandler>(id)->setValue(newValue.getAsRGBW());
+				return true;
+			case BinaryElementType::Button:
+				getHandler<ITriggerHandler>(id)->onTrigger();
+				return true;
+			case BinaryElementType::Root:
+			case BinaryElementType::Group:
+				break;
+		}
+
+		return false;
+	}
+
+	virtual void notifyValuesCommitted() override {
+		if (onValuesCommittedCallback) {
+			onValuesCommittedCallback();
+		}
+	}
+
+	virtual bool getElementFlagById(uint16_t id, GUIFlag flag) const override {
+		if (id >= derived().getElementCount())
+			return false;
+
+		return derived().getFlags(id) & FlagBit(flag);
+	}
+
+	virtual void setElementFlagById(uint16_t id, GUIFlag flag, bool newState) override {
+		if (id >= derived().getElementCount())
+			return;
+
+		uint8_t flags = derived().getFlags(id);
+		derived().setFlags(id, newState ? (flags | FlagBit(flag)) : (flags & ~FlagBit(flag)));
+		invalidateStructureHash();
+	}
+
+	virtual uint32_t getElementPublishIntervalById(uint16_t id) const override {
+		if (id >= derived().getElementCount())
+			return 0;
+
+		return derived().getPublishInterval(id);
+	}
+
+	virtual uint32_t getStructureHash() const override {
+		if (!structureHash) {
+			structureHash = getJSONTemplate()->computeStructureHash();
+		}
+
+		return *structureHash;
+	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = writer.beginElement(BinaryElementType::Root, 0, INVALID_ELEMENT_ID, "");
+
+		for (uint16_t id = derived().getFirstElement(); id != INVALID_ELEMENT_ID; id = derived().getRecord(id).nextSibling) {
+			appendElementBinarySchema(writer, id);
+		}
+
+		writer.endElement(start);
+	}
+
+	virtual std::shared_ptr<const JSONTemplate> getJSONTemplate() const override {
+		return getSubtreeJSONTemplate(INVALID_ELEMENT_ID, UNLIMITED_SUBTREE_DEPTH);
+	}
+
+	virtual std::shared_ptr<const JSONTemplate> getSubtreeJSONTemplate(uint16_t id, uint8_t depth) const override {
+		if (id != INVALID_ELEMENT_ID && id >= derived().getElementCount())
+			return nullptr;
+
+		std::shared_ptr<JSONTemplateWithSlots> result = std::make_shared<JSONTemplateWithSlots>();
+		// Reserve all slots upfront, the template points to them
+		result->valueSlots.reserve(derived().getElementCount());
+
+		if (id != INVALID_ELEMENT_ID) {
+			appendElementJSONTemplate(*result, id, depth);
+		} else if (depth == 0) {
+			result->appendText("{\"type\":\"root\",\"name\": \"\",\"lazy\":true,\"elements\":[]}");
+		} else {
+			result->appendText("{\"type\":\"root\",\"name\": \"\",\"elements\":[");
+			appendElementsJSONTemplate(*result, derived().getFirstElement(), GetChildSubtreeDepth(depth));
+			result->appendText("]}");
+		}
+
+		return result;
+	}
+
+	void appendElementBinarySchema(BinarySchemaWriter& writer, uint16_t id) const {
+		const ElementTableRecord& record = derived().getRecord(id);
+		size_t start = writer.beginElement(record.type, derived().getFlags(id), id, getElementName(id));
+
+		switch (record.type) {
+			case BinaryElementType::Group:
+				for (uint16_t child = record.firstChild; child != INVALID_ELEMENT_ID; child = derived().getRecord(child).nextSibling) {
+					appendElementBinarySchema(writer, child);
+				}
+				break;
+			case BinaryElementType::Range:
+				writer.writeInt32(record.min);
+				writer.writeInt32(record.max);
+				writer.writeInt32(getValueOrDefault<IInt32DataHandler>(id, 0));
+				break;
+			case BinaryElementType::Checkbox:
+				writer.writeUInt8(getValueOrDefault<IBoolDataHandler>(id, false));
+				break;
+			case BinaryElementType::Radio:
+			case BinaryElementType::DropDown: {
+				writer.writeVarUInt(record.itemCount);
+
+				const char* item = getElementStrings(id);
+
+				for (size_t i = 0; i < record.itemCount; ++i) {
+					writer.writeString(item);
+					item += std::strlen(item) + 1;
+				}
+
+				writer.writeVarUInt(getValueOrDefault<IUInt16DataHandler>(id, 0));
+				break;
+			}
+			case BinaryElementType::NumberFieldInt32:
+				writer.writeInt32(getValueOrDefault<IInt32DataHandler>(id, 0));
+				break;
+			case BinaryElementType::TextField:
+				writer.writeVarUInt(record.maxLength);
+				writer.writeString(getValueOrDefault<IStringDataHandler>(id, ""));
+				break;
+			case BinaryElementType::PasswordField:
+				writer.writeVarUInt(record.maxLength);
+				writer.writeString("");
+				break;
+			case BinaryElementType::RGBWRange:
+				writer.writeString(getElementStrings(id));
+				writer.writeUInt32(getPackedColorOrDefault(id));
+				break;
+			case BinaryElementType::Compass:
+				writer.writeFloat32(float(getValueOrDefault<IInt32DataHandler>(id, 0)));
+				break;
+			case BinaryElementType::Root:
+			case BinaryElementType::Button:
+				break;
+		}
+
+		writer.endElement(start);
+	}
+
+	/**
+	 * Appends the given element and all following siblings, separated by commas.
+	 * Groups are appended up to the depth, see IGUIModel::getSubtreeJSONTemplate().
+	 */
+	void appendElementsJSONTemplate(JSONTemplateWithSlots& target, uint16_t first, uint8_t depth) const {
+		for (uint16_t id = first; id != INVALID_ELEMENT_ID; id = derived().getRecord(id).nextSibling) {
+			if (id != first) {
+				target.appendText(",");
+			}
+
+			appendElementJSONTemplate(target, id, depth);
+		}
+	}
+
+	void appendElementJSONTemplate(JSONTemplateWithSlots& target, uint16_t id, uint8_t depth) const {
+		const ElementTableRecord& record = derived().getRecord(id);
+		uint8_t flags = derived().getFlags(id);
+
+		std::string prefix = "{\"type\":\""_s + GetTypeName(record.type) + "\",\"name\": \""_s;
+		prefix.append(getElementName(id));
+		prefix += "\",\"id\":"_s + std::to_string(id);
+
+		if (flags & BINARY_FLAG_ADVANCED) {
+			prefix += ",\"advanced\":true";
+		}
+
+		if (flags & BINARY_FLAG_READ_ONLY) {
+			prefix += ",\"readOnly\":true";
+		}
+
+		switch (record.type) {
+			case BinaryElementType::Group:
+				if (flags & BINARY_FLAG_COLLAPSABLE) {
+					prefix += ",\"collapsed\":"_s + ((flags & BINARY_FLAG_COLLAPSED) ? "true" : "false");
+				}
+
+				if (depth == 0) {
+					target.appendText(prefix + ",\"lazy\":true,\"elements\":[]}");
+					return;
+				}
+
+				target.appendText(prefix + ",\"elements\":[");
+				appendElementsJSONTemplate(target, record.firstChild, GetChildSubtreeDepth(depth));
+				target.appendText("]}");
+				return;
+			case BinaryElementType::Button:
+				target.appendText(prefix + "}");
+				return;
+			case BinaryElementType::Range:
+				prefix += ",\"min\":"_s + std::to_string(record.min) + ",\"max\":"_s + std::to_string(record.max);
+				break;
+			case BinaryElementType::Radio:
+			case BinaryElementType::DropDown: {
+				prefix += ",\"items\":[";
+
+				const char* item = getElementStrings(id);
+
+				for (size_t i = 0; i < record.itemCount; ++i) {
+					prefix += "\""_s + item + "\"";
+					item += std::strlen(item) + 1;
+
+					if (i + 1 < record.itemCount) {
+						prefix += ",";
+					}
+				}
+
+				prefix += "]";
+				break;
+			}
+			case BinaryElementType::TextField:
+			case BinaryElementType::PasswordField:
+				prefix += ",\"maxLength\":"_s + std::to_string(record.maxLength);
+				break;
+			case BinaryElementType::RGBWRange:
+				prefix += ",\"channel\":\""_s + getElementStrings(id) + "\"";
+				break;
+			case BinaryElementType::Root:
+			case BinaryElementType::Checkbox:
+			case BinaryElementType::NumberFieldInt32:
+			case BinaryElementType::Compass:
+				break;
+		}
+
+		target.appendText(prefix + ",");
+		target.appendValue(&target.valueSlots.emplace_back(this, id));
+		target.appendText("}");
+	}
+
+	std::string toJSONValueField(uint16_t id) const {
+		switch (derived().getRecord(id).type) {
+			case BinaryElementType::Range:
+			case BinaryElementType::NumberFieldInt32:
+			case BinaryElementType::Compass:
+				return "\"value\":"_s + std::to_string(getValueOrDefault<IInt32DataHandler>(id, 0));
+			case BinaryElementType::Checkbox:
+				return "\"value\":"_s + (getValueOrDefault<IBoolDataHandler>(id, false) ? "1" : "0");
+			case BinaryElementType::Radio:
+			case BinaryElementType::DropDown:
+				return "\"value\":"_s + std::to_string(getValueOrDefault<IUInt16DataHandler>(id, 0));
+			case BinaryElementType::TextField:
+				return "\"value\":\""_s + getValueOrDefault<IStringDataHandler>(id, "") + "\"";
+			case BinaryElementType::PasswordField:
+				return "\"value\":\"\"";
+			case BinaryElementType::RGBWRange:
+				return "\"value\":"_s + std::to_string(getPackedColorOrDefault(id));
+			case BinaryElementType::Root:
+			case BinaryElementType::Group:
+			case BinaryElementType::Button:
+				break;
+		}
+
+		return "";
+	}
+
+	template <typename HandlerType, typename ValueType>
+	auto getValueOrDefault(uint16_t id, const ValueType& defaultValue) const -> decltype(std::declval<HandlerType>().getValue()) {
+		HandlerType* handler = getHandler<HandlerType>(id);
+		return handler ? handler->getValue() : defaultValue;
+	}
+
+	uint32_t getPackedColorOrDefault(uint16_t id) const {
+		IRGBWDataHandler* handler = getHandler<IRGBWDataHandler>(id);
+		return handler ? handler->getValue().getAsPackedColor() : 0;
+	}
+
+	static uint8_t FlagBit(GUIFlag flag) {
+		return flag == GUIFlag::ReadOnly ? BINARY_FLAG_READ_ONLY : BINARY_FLAG_ADVANCED;
+	}
+
+	static const char* GetTypeName(BinaryElementType type) {
+		switch (type) {
+			case BinaryElementType::Root: return "root";
+			case BinaryElementType::Group: return "group";
+			case BinaryElementType::Range: return "range";
+			case BinaryElementType::Checkbox: return "checkbox";
+			case BinaryElementType::Radio: return "radio";
+			case BinaryElementType::DropDown: return "dropdown";
+			case BinaryElementType::Button: return "button";
+			case BinaryElementType::NumberFieldInt32: return "numberfield_int32";
+			case BinaryElementType::TextField: return "textfield";
+			case BinaryElementType::PasswordField: return "password";
+			case BinaryElementType::RGBWRange: return "RGBWRange";
+			case BinaryElementType::Compass: return "Compass";
+		}
+
+		return "";
+	}
+};
+
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "ElementTableGUI.h"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace webgui {
+
+/**
+ * GUI build at runtime into a flat element table, alternative to the RootElement.
+ *
+ * All elements are stored in a few contiguous arrays (records, string pool, path lookup, handlers and flags)
+ * instead of one object per element, the element is referenced by its id:
+ *
+ *  webgui::FlatGUI gui;
+ *  uint16_t light = gui.addGroup(webgui::INVALID_ELEMENT_ID, "Light");
+ *  uint16_t brightness = gui.addRange(light, "Brightness", 0, 255, brightnessHandler);
+ *
+ * Elements are added with the id of their group, INVALID_ELEMENT_ID for top level elements.
+ * The add functions return INVALID_ELEMENT_ID when the element can't be added.
+ * The generated GUI description matches the one of an equal RootElement.
+ */
+struct FlatGUI final : public ElementTableGUI<FlatGUI> {
+	std::vector<ElementTableRecord> records;
+	std::vector<char> pool;
+	std::vector<uint16_t> sortedIds;
+	std::vector<std::shared_ptr<void>> handlers;
+	std::vector<uint8_t> flags;
+	// Publish interval by element id, only allocated up to the last element with an interval
+	std::vector<uint32_t> publishIntervals;
+
+	uint16_t firstElement;
+
+	FlatGUI() :
+		records(),
+		pool(),
+		sortedIds(),
+		handlers(),
+		flags(),
+		publishIntervals(),
+		firstElement(INVALID_ELEMENT_ID) {}
+
+	/**
+	 * Reserves the memory for the given amount of elements and string pool size, avoids reallocations while adding.
+	 */
+	void reserve(uint16_t elementCount, size_t poolSize) {
+		records.reserve(elementCount);
+		pool.reserve(poolSize);
+		sortedIds.reserve(elementCount);
+		handlers.reserve(elementCount);
+		flags.reserve(elementCount);
+	}
+
+	uint16_t addGroup(uint16_t parent, std::string_view name) {
+		return addElement(parent, BinaryElementType::Group, name, nullptr);
+	}
+
+	uint16_t addRange(uint16_t parent, std::string_view name, int32_t min, int32_t max, std::shared_ptr<IInt32DataHandler> handler) {
+		uint16_t id = addElement(parent, BinaryElementType::Range, name, handler);
+
+		if (id != INVALID_ELEMENT_ID) {
+			records[id].min = min;
+			records[id].max = max;
+		}
+
+		return id;
+	}
+
+	uint16_t addCheckbox(uint16_t parent, std::string_view name, std::shared_ptr<IBoolDataHandler> handler) {
+		return addElement(parent, BinaryElementType::Checkbox, name, handler);
+	}
+
+	uint16_t addRadio(uint16_t parent, std::string_view name, const std::vector<std::string>& items, std::shared_ptr<IUInt16DataHandler> dataHandler) {
+		return addItemsElement(parent, BinaryElementType::Radio, name, items, dataHandler);
+	}
+
+	uint16_t addDropDown(uint16_t parent, std::string_view name, const std::vector<std::string>& items, std::shared_ptr<IUInt16DataHandler> dataHandler) {
+		return addItemsElement(parent, BinaryElementType::DropDown, name, items, dataHandler);
+	}
+
+	uint16_t addButton(uint16_t parent, std::string_view name, std::shared_ptr<ITriggerHandler> triggerHandler) {
+		return addElement(parent, BinaryElementType::Button, name, triggerHandler);
+	}
+
+	uint16_t addNumberFieldInt32(uint16_t parent, std::string_view name, std::shared_ptr<IInt32DataHandler> handler) {
+		return addElement(parent, BinaryElementType::NumberFieldInt32, name, handler);
+	}
+
+	uint16_t addTextField(uint16_t parent, std::string_view name, std::shared_ptr<IStringDataHandler> handler, uint16_t maxLength) {
+		uint16_t id = addElement(parent, BinaryElementType::TextField, name, handler);
+
+		if (id != INVALID_ELEMENT_ID) {
+			records[id].maxLength = maxLength;
+		}
+
+		return id;
+	}
+
+	uint16_t addPasswordField(uint16_t parent, std::string_view name, std::shared_ptr<IStringDataHandler> handler, uint16_t maxLength) {
+		uint16_t id = addElement(parent, BinaryElementType::PasswordField, name, handler);
+
+		if (id != INVALID_ELEMENT_ID) {
+			records[id].maxLength = maxLength;
+		}
+
+		return id;
+	}
+
+	uint16_t addRGBWRangeControl(uint16_t parent, std::string_view name, std::shared_ptr<IRGBWDataHandler> handler, const char* channelString = "RGBW") {
+		uint16_t id = addElement(parent, BinaryElementType::RGBWRange, name, handler);
+
+		if (id != INVALID_ELEMENT_ID) {
+			appendPoolString(channelString);
+		}
+
+		return id;
+	}
+
+	uint16_t addCompassi(uint16_t parent, std::string_view name, std::shared_ptr<IDataHandler<int32_t>> handler) {
+		return addElement(parent, BinaryElementType::Compass, name, handler);
+	}
+
+	void setAdvanced(uint16_t id, bool advanced = true) {
+		setElementFlagById(id, GUIFlag::Advanced, advanced);
+	}
+
+	void setReadOnly(uint16_t id, bool readOnly = true) {
+		setElementFlagById(id, GUIFlag::ReadOnly, readOnly);
+	}
+
+	/**
+	 * Publishes the value periodically, at most once per interval and only when it changed.
+	 * The value is read from the telemetry thread, see IGUIModel::getElementPublishIntervalById().
+	 * \param intervalMs 0 to disable
+	 */
+	void setPublishInterval(uint16_t id, uint32_t intervalMs) {
+		if (id >= records.size())
+			return;
+
+		if (id >= publishIntervals.size()) {
+			publishIntervals.resize(id + 1, 0);
+		}
+
+		publishIntervals[id] = intervalMs;
+	}
+
+	/**
+	 * Makes the group collapsable and sets the initial state.
+	 */
+	void setCollapsed(uint16_t id, bool collapsed) {
+		setGroupFlags(id, BINARY_FLAG_COLLAPSABLE | (collapsed ? BINARY_FLAG_COLLAPSED : 0));
+	}
+
+	void setCollapsable(uint16_t id, bool collapsable) {
+		setGroupFlags(id, collapsable ? BINARY_FLAG_COLLAPSABLE : 0);
+	}
+
+	virtual uint16_t getElementCount() const override {
+		return records.size();
+	}
+
+	const ElementTableRecord& getRecord(uint16_t id) const {
+		return records[id];
+	}
+
+	const char* getPool() const {
+		return pool.data();
+	}
+
+	const uint16_t* getSortedIds() const {
+		return sortedIds.data();
+	}
+
+	uint16_t getFirstElement() const {
+		return firstElement;
+	}
+
+	void* getHandlerPointer(uint16_t id) const {
+		return handlers[id].get();
+	}
+
+	uint32_t getPublishInterval(uint16_t id) const {
+		return (id < publishIntervals.size()) ? publishIntervals[id] : 0;
+	}
+
+	uint8_t getFlags(uint16_t id) const {
+		return flags[id];
+	}
+
+	void setFlags(uint16_t id, uint8_t newFlags) {
+		flags[id] = newFlags;
+	}
+
+	private:
+		uint16_t addItemsElement(uint16_t parent, BinaryElementType type, std::string_view name, const std::vector<std::string>& items, std::shared_ptr<IUInt16DataHandler> dataHandler) {
+			uint16_t id = addElement(parent, type, name, dataHandler);
+
+			if (id != INVALID_ELEMENT_ID) {
+				records[id].itemCount = items.size();
+
+				for (const std::string& item : items) {
+					appendPoolString(item.c_str());
+				}
+			}
+
+			return id;
+		}
+
+		/**
+		 * Appends the record and path of a new element as last child of the parent.
+		 * The strings of the element (items, channel) must be appended to the pool directly afterwards.
+		 */
+		uint16_t addElement(uint16_t parent, BinaryElementType type, std::string_view name, std::shared_ptr<void> handler) {
+			if (records.size() >= INVALID_ELEMENT_ID - 1)
+				return INVALID_ELEMENT_ID;
+
+			if (parent != INVALID_ELEMENT_ID && (parent >= records.size() || records[parent].type != BinaryElementType::Group))
+				return INVALID_ELEMENT_ID;
+
+			uint16_t id = records.size();
+			ElementTableRecord record = {};
+
+			record.type = type;
+			record.parent = parent;
+			record.firstChild = INVALID_ELEMENT_ID;
+			record.nextSibling = INVALID_ELEMENT_ID;
+			record.pathOffset = pool.size();
+
+			if (parent != INVALID_ELEMENT_ID) {
+				// Copy by index, the pool may be reallocated while appending
+				for (size_t i = 0; i < records[parent].pathLength; ++i) {
+					pool.push_back(pool[records[parent].pathOffset + i]);
+				}
+
+				pool.push_back(',');
+			}
+
+			pool.insert(pool.end(), name.begin(), name.end());
+
+			record.pathLength = pool.size() - record.pathOffset;
+			record.nameLength = name.size();
+			record.stringsOffset = pool.size();
+
+			records.push_back(record);
+			handlers.push_back(std::move(handler));
+			flags.push_back(0);
+
+			linkAsLastChild(parent, id);
+
+			// Equal paths are inserted behind the existing ones, the lookup finds the first element (same as the RootElement)
+			std::string_view path = getElementPath(id);
+			sortedIds.insert(std::upper_bound(sortedIds.begin(), sortedIds.end(), path, [this](std::string_view path, uint16_t other) {
+				return path < getElementPath(other);
+			}), id);
+
+			invalidateStructureHash();
+
+			return id;
+		}
+
+		void linkAsLastChild(uint16_t parent, uint16_t id) {
+			uint16_t& first = (parent == INVALID_ELEMENT_ID) ? firstElement : records[parent].firstChild;
+
+			if (first == INVALID_ELEMENT_ID) {
+				first = id;
+				return;
+			}
+
+			uint16_t last = first;
+
+			while (records[last].nextSibling != INVALID_ELEMENT_ID) {
+				last = records[last].nextSibling;
+			}
+
+			records[last].nextSibling = id;
+		}
+
+		void appendPoolString(const char* str) {
+			pool.insert(pool.end(), str, str + std::strlen(str) + 1);
+		}
+
+		void setGroupFlags(uint16_t id, uint8_t groupFlags) {
+			if (id >= records.size() || records[id].type != BinaryElementType::Group)
+				return;
+
+			flags[id] = (flags[id] & ~(BINARY_FLAG_COLLAPSABLE | BINARY_FLAG_COLLAPSED)) | groupFlags;
+			invalidateStructureHash();
+		}
+};
+
+}
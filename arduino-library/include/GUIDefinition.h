@@ -2,4 +2,6 @@
 
 #include "ValueWrapper.h"
 #include "GUIElements.h"
+#include "StaticGUI.h"
+#include "FlatGUI.h"
 #include "DataHandler.h"
@@ -1,22 +1,44 @@
 #pragma once
 
 #include "GUIFlag.h"
+#include "GUIModel.h"
 
 #include "Literals.h"
+#include "BinarySchemaWriter.h"
 #include "ValueWrapper.h"
 #include "DataHandler.h"
 #include "TriggerHandler.h"
 
 #include <sstream>
 #include <vector>
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 
 namespace webgui {
 
 struct GroupElement;
+struct JSONTemplate;
 
-struct IControlElement {
-	virtual ~IControlElement() = default;
+/**
+ * Source of a value slot inside a JSONTemplate.
+ */
+struct IJSONValueSource {
+	virtual ~IJSONValueSource() = default;
+
+	/**
+	 * \return the JSON value field (e.g. "value":42) with the current value,
+	 * empty when there is no value.
+	 */
+	virtual std::string toJSONValueField() const = 0;
+};
+
+struct IControlElement : public IJSONValueSource {
 
 	/**
 	 * \return the name of this element.
@@ -33,25 +55,170 @@ struct IControlElement {
 	 */
 	virtual std::string toJSON() const = 0;
 
+	/**
+	 * Appends the JSON representation of this element (and all child elements) to the template.
+	 * The value is added as value slot, so the template stays valid when the value changes.
+	 */
+	virtual void appendJSONTemplate(JSONTemplate& target) const = 0;
+
+	/**
+	 * Appends the JSON representation up to the given depth, deeper groups are placeholders, see IGUIModel::getSubtreeJSONTemplate().
+	 * Only groups have children, all other elements are appended completely.
+	 */
+	virtual void appendSubtreeJSONTemplate(JSONTemplate& target, uint8_t /*depth*/) const {
+		appendJSONTemplate(target);
+	}
+
+	/**
+	 * Appends this and all child elements in the binary schema format.
+	 */
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const = 0;
+
 	/**
 	 * \return the current value of the element.
 	 */
-	virtual std::unique_ptr<AValueWrapper> getValue(const std::vector<std::string>& path) const = 0;
+	virtual std::optional<Value> getValue(const std::vector<std::string>& path) const = 0;
 
 	/**
 	 * Sets a new value to the element and invoces the callback handling.
 	 */
-	virtual bool setValue(const std::vector<std::string>& path, const AValueWrapper& newValue) = 0;
+	virtual bool setValue(const std::vector<std::string>& path, const Value& newValue) = 0;
+
+	/**
+	 * \return the current value of this element itself, without any path resolving.
+	 */
+	virtual std::optional<Value> getElementValue() const = 0;
+
+	/**
+	 * Sets a new value directly on this element, without any path resolving.
+	 * \return false when the element does not accept values.
+	 */
+	virtual bool setElementValue(const Value& newValue) = 0;
 
 	virtual bool getFlag(GUIFlag flag) const = 0;
 	virtual void setFlag(GUIFlag flag, bool newValue) = 0;
 
+	/**
+	 * \return the interval (ms) in which the value is published, 0 when not published periodically.
+	 */
+	virtual uint32_t getPublishInterval() const = 0;
+
 	virtual IControlElement* getElementByPath(const std::vector<std::string>& path) = 0;
+
+	/**
+	 * \return the numeric id assigned by the RootElement, used as compact reference on the wire.
+	 */
+	virtual uint16_t getElementId() const = 0;
+	virtual void setElementId(uint16_t id) = 0;
+};
+
+/**
+ * Pre-serialized JSON structure of a GUI (sub)tree.
+ *
+ * Consists of static text segments, value slots which are rendered on demand
+ * and references to the (cached) templates of sub groups.
+ * Rendering a template only serializes the current values of the elements.
+ */
+struct JSONTemplate {
+	struct Segment {
+		std::string text;
+		const IJSONValueSource* valueElement;
+		std::shared_ptr<const JSONTemplate> subTemplate;
+	};
+
+	std::vector<Segment> segments;
+	size_t textLength;	// Sum of all static text, including the sub templates
+	size_t valueCount;	// Amount of value slots, including the sub templates
+
+	JSONTemplate() :
+		segments(),
+		textLength(0),
+		valueCount(0) {}
+
+	void appendText(const std::string& text) {
+		if (!segments.empty() && !segments.back().valueElement && !segments.back().subTemplate) {
+			segments.back().text += text;
+		} else {
+			segments.push_back({text, nullptr, nullptr});
+		}
+
+		textLength += text.size();
+	}
+
+	void appendValue(const IJSONValueSource* element) {
+		segments.push_back({"", element, nullptr});
+		valueCount++;
+	}
+
+	void appendTemplate(std::shared_ptr<const JSONTemplate> subTemplate) {
+		textLength += subTemplate->textLength;
+		valueCount += subTemplate->valueCount;
+		segments.push_back({"", nullptr, std::move(subTemplate)});
+	}
+
+	/**
+	 * Calls onText(const std::string&) for every static text and onValue(const IJSONValueSource&)
+	 * for every value slot, in document order.
+	 */
+	template <typename TextFunction, typename ValueFunction>
+	void visit(TextFunction&& onText, ValueFunction&& onValue) const {
+		for (const Segment& segment : segments) {
+			if (segment.valueElement) {
+				onValue(*segment.valueElement);
+			} else if (segment.subTemplate) {
+				segment.subTemplate->visit(onText, onValue);
+			} else {
+				onText(segment.text);
+			}
+		}
+	}
+
+	/**
+	 * Renders the template with the current values into a JSON string.
+	 */
+	std::string render() const {
+		std::string result;
+		result.reserve(textLength + valueCount * 16);
+
+		visit([&](const std::string& text) {
+			result += text;
+		}, [&](const IJSONValueSource& element) {
+			result += element.toJSONValueField();
+		});
+
+		return result;
+	}
+
+	/**
+	 * \return a hash (FNV-1a) over the static text and the positions of the value slots,
+	 * independent of the current values.
+	 */
+	uint32_t computeStructureHash() const {
+		uint32_t hash = 2166136261u;
+
+		auto hashByte = [&](uint8_t byte) {
+			hash ^= byte;
+			hash *= 16777619u;
+		};
+
+		visit([&](const std::string& text) {
+			for (char c : text) {
+				hashByte(c);
+			}
+		}, [&](const IJSONValueSource&) {
+			// Only mark the position of the value slot, the value itself is not part of the structure
+			hashByte(0);
+		});
+
+		return hash;
+	}
 };
 
 template <typename Derived>
 struct AControlElement : public IControlElement {
 	std::string name;
+	uint16_t elementId;
+	uint32_t publishInterval;
 
 	bool isAdvanced:1;
 	bool isReadOnly:1;
@@ -59,6 +226,8 @@ struct AControlElement : public IControlElement {
 	AControlElement(const std::string& name) :
 		IControlElement(),
 		name(name),
+		elementId(INVALID_ELEMENT_ID),
+		publishInterval(0),
 		isAdvanced(false),
 		isReadOnly(false) {}
 
@@ -70,10 +239,22 @@ struct AControlElement : public IControlElement {
 		return name;
 	}
 
+	virtual uint16_t getElementId() const override {
+		return elementId;
+	}
+
+	virtual void setElementId(uint16_t id) override {
+		elementId = id;
+	}
+
 	std::string jsonPrefix() const {
 		std::string type = getElementTypeName();
 		std::string prefix = "{\"type\":\""_s + type + "\",\"name\": \""_s + name + "\"";
 
+		if (elementId != INVALID_ELEMENT_ID) {
+			prefix += ',' + jsonField("id", uint32_t(elementId));
+		}
+
 		if (isAdvanced) {
 			prefix += ',' + jsonField("advanced", true);
 		}
@@ -94,15 +275,11 @@ struct AControlElement : public IControlElement {
 	}
 
 	std::string jsonField(const std::string& name, int32_t value) const {
-		std::stringstream s;
-		s << value;
-		return jsonField(name, s.str(), false);
+		return jsonField(name, std::to_string(value), false);
 	}
 
 	std::string jsonField(const std::string& name, uint32_t value) const {
-		std::stringstream s;
-		s << value;
-		return jsonField(name, s.str(), false);
+		return jsonField(name, std::to_string(value), false);
 	}
 
 	std::string jsonField(const std::string& name, float value) const {
@@ -131,16 +308,77 @@ struct AControlElement : public IControlElement {
 		return jsonValueField(value ? int32_t(1) : int32_t(0));
 	}
 
+	std::string jsonValueField(float value) const {
+		return jsonField("value", value);
+	}
+
+	/**
+	 * Appends the template of a element with a value: The prefix, the given additional fields
+	 * (must start with a comma when not empty), the value slot and the closing bracket.
+	 */
+	void appendJSONTemplateWithValue(JSONTemplate& target, const std::string& fields) const {
+		target.appendText(jsonPrefix() + fields + ",");
+		target.appendValue(this);
+		target.appendText("}");
+	}
+
+	virtual std::string toJSON() const override {
+		JSONTemplate jsonTemplate;
+		appendJSONTemplate(jsonTemplate);
+		return jsonTemplate.render();
+	}
+
+	/**
+	 * Writes the binary element head with the common flags, see BinarySchemaWriter::beginElement().
+	 */
+	size_t beginBinarySchema(BinarySchemaWriter& writer, BinaryElementType type, uint8_t additionalFlags = 0) const {
+		uint8_t flags = additionalFlags;
+
+		if (isAdvanced) {
+			flags |= BINARY_FLAG_ADVANCED;
+		}
+
+		if (isReadOnly) {
+			flags |= BINARY_FLAG_READ_ONLY;
+		}
+
+		return writer.beginElement(type, flags, elementId, name);
+	}
+
+	/**
+	 * Called when a property which is part of the JSON structure was changed.
+	 */
+	virtual void onStructureChanged() {}
+
 	Derived* setAdvanced(bool advanced = true) {
 		this->isAdvanced = advanced;
+		onStructureChanged();
 		return static_cast<Derived*>(this);
 	}
 
 	Derived* setReadOnly(bool readOnly = true) {
 		this->isReadOnly = readOnly;
+		onStructureChanged();
+		return static_cast<Derived*>(this);
+	}
+
+	/**
+	 * Publishes the value periodically, at most once per interval and only when it changed.
+	 * Intended for read only outputs like sensor values, the data handler is sampled by the WebGUIHandler.
+	 * Calls of notifyGUIValueChange() are then limited to the same rate.
+	 * The data handler is read from the telemetry thread while the application runs, the value must be safe to read
+	 * from another thread (e.g. a std::atomic, or a getter which locks the mutex of the application data).
+	 * \param intervalMs 0 to disable
+	 */
+	Derived* setPublishInterval(uint32_t intervalMs) {
+		this->publishInterval = intervalMs;
 		return static_cast<Derived*>(this);
 	}
 
+	virtual uint32_t getPublishInterval() const override {
+		return publishInterval;
+	}
+
 	virtual bool getFlag(GUIFlag flag) const override {
 		switch (flag) {
 			case GUIFlag::Advanced:
@@ -185,6 +423,11 @@ struct AControlElementWithParent : public AControlElement<Derived> {
 	bool isValidPath(const std::vector<std::string>& path) const {
 		return path.size() == 1 && path[0] == this->name;
 	}
+
+	/**
+	 * Invalidates the cached JSON template of the parent groups.
+	 */
+	virtual void onStructureChanged() override;
 };
 
 template <typename ValueHandlerType, typename Derived>
@@ -195,22 +438,36 @@ struct AControlElementWithParentAndValue : public AControlElementWithParent<Deri
 		AControlElementWithParent<Derived>(parent, name),
 		dataHandler(dataHandler) {}
 
-	virtual std::unique_ptr<AValueWrapper> getValue(const std::vector<std::string>& path) const override {
-		if (!this->isValidPath(path) || !dataHandler)
-			return nullptr;
+	virtual std::optional<Value> getValue(const std::vector<std::string>& path) const override {
+		if (!this->isValidPath(path))
+			return {};
+
+		return getElementValue();
+	}
+
+	virtual bool setValue(const std::vector<std::string>& path, const Value& newValue) override {
+		if (!this->isValidPath(path))
+			return false;
+
+		return setElementValue(newValue);
+	}
+
+	virtual std::optional<Value> getElementValue() const override {
+		if (!dataHandler)
+			return {};
 
 		return WrapValue(dataHandler->getValue());
 	}
 
-	virtual bool setValue(const std::vector<std::string>& path, const AValueWrapper& newValue) override {
-		if (!this->isValidPath(path) || !dataHandler)
+	virtual bool setElementValue(const Value& newValue) override {
+		if (!dataHandler)
 			return false;
 
 		setValue(newValue);
 		return true;
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) = 0;
+	virtual void setValue(const Value& newValue) = 0;
 };
 
 struct RangeElement : public AControlElementWithParentAndValue<IInt32DataHandler, RangeElement> {
@@ -228,22 +485,23 @@ struct RangeElement : public AControlElementWithParentAndValue<IInt32DataHandler
 		return "range";
 	}
 
-	virtual std::string toJSON() const override {
-		std::stringstream s;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		appendJSONTemplateWithValue(target, ","_s + jsonField("min", min) + ","_s + jsonField("max", max));
+	}
 
-		s << jsonPrefix();
-		s << ",\"min\":"_s;
-		s << min;
-		s << ",\"max\":"_s;
-		s << max;
-		s << ",";
-		s << jsonValueField(dataHandler ? dataHandler->getValue() : int32_t(0));
-		s << "}";
+	virtual std::string toJSONValueField() const override {
+		return jsonValueField(dataHandler ? dataHandler->getValue() : int32_t(0));
+	}
 
-		return s.str();
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = beginBinarySchema(writer, BinaryElementType::Range);
+		writer.writeInt32(min);
+		writer.writeInt32(max);
+		writer.writeInt32(dataHandler ? dataHandler->getValue() : int32_t(0));
+		writer.endElement(start);
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	virtual void setValue(const Value& newValue) override {
 		int32_t actualValue = std::clamp(newValue.getAsInt32(), min, max);
 		dataHandler->setValue(actualValue);
 	}
@@ -261,11 +519,21 @@ struct CheckboxElement : public AControlElementWithParentAndValue<IBoolDataHandl
 		return "checkbox";
 	}
 
-	virtual std::string toJSON() const override {
-		return jsonPrefix() + ","_s + jsonValueField(dataHandler ? dataHandler->getValue() : false) + "}"_s;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		appendJSONTemplateWithValue(target, "");
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	virtual std::string toJSONValueField() const override {
+		return jsonValueField(dataHandler ? dataHandler->getValue() : false);
+	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = beginBinarySchema(writer, BinaryElementType::Checkbox);
+		writer.writeUInt8(dataHandler ? dataHandler->getValue() : false);
+		writer.endElement(start);
+	}
+
+	virtual void setValue(const Value& newValue) override {
 		dataHandler->setValue(newValue.getAsBool());
 	}
 };
@@ -278,29 +546,41 @@ struct AElementWithItems : public AControlElementWithParentAndValue<IUInt16DataH
 		AControlElementWithParentAndValue<IUInt16DataHandler, Derived>(parent, name, dataHandler),
 		items(items) {}
 
-	virtual std::string toJSON() const override {
-		std::stringstream s;
-		s << this->jsonPrefix();
-		s << ",\"items\":[";
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		std::string fields = ",\"items\":[";
 
 		size_t index = 0;
 
 		for (const std::string& item : items) {
-			s << "\"" << item << "\"";
+			fields += "\"" + item + "\"";
 
 			if (index++ < items.size() - 1) {
-				s << ",";
+				fields += ",";
 			}
 		}
 
-		s << "],";
-		s << this->jsonValueField(this->dataHandler ? this->dataHandler->getValue() : int32_t(0));
-		s << "}";
+		fields += "]";
+
+		this->appendJSONTemplateWithValue(target, fields);
+	}
+
+	virtual std::string toJSONValueField() const override {
+		return this->jsonValueField(this->dataHandler ? int32_t(this->dataHandler->getValue()) : int32_t(0));
+	}
+
+	void appendBinarySchemaWithItems(BinarySchemaWriter& writer, BinaryElementType type) const {
+		size_t start = this->beginBinarySchema(writer, type);
+		writer.writeVarUInt(items.size());
+
+		for (const std::string& item : items) {
+			writer.writeString(item);
+		}
 
-		return s.str();
+		writer.writeVarUInt(this->dataHandler ? this->dataHandler->getValue() : 0);
+		writer.endElement(start);
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	virtual void setValue(const Value& newValue) override {
 		uint16_t valueIndex = std::clamp<int16_t>(newValue.getAsInt32(), 0, items.size());
 		this->dataHandler->setValue(valueIndex);
 	}
@@ -317,6 +597,10 @@ struct RadioElement : public AElementWithItems<RadioElement> {
 	virtual const char* getElementTypeName() const override {
 		return "radio";
 	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		appendBinarySchemaWithItems(writer, BinaryElementType::Radio);
+	}
 };
 
 struct DropDownElement : public AElementWithItems<DropDownElement> {
@@ -330,6 +614,10 @@ struct DropDownElement : public AElementWithItems<DropDownElement> {
 	virtual const char* getElementTypeName() const override {
 		return "dropdown";
 	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		appendBinarySchemaWithItems(writer, BinaryElementType::DropDown);
+	}
 };
 
 struct ButtonElement : public AControlElementWithParent<ButtonElement> {
@@ -347,19 +635,39 @@ struct ButtonElement : public AControlElementWithParent<ButtonElement> {
 		return "button";
 	}
 
-	virtual std::string toJSON() const override {
-		return this->jsonPrefix() + "}"_s;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		target.appendText(this->jsonPrefix() + "}"_s);
 	}
 
-	virtual std::unique_ptr<AValueWrapper> getValue(const std::vector<std::string>& path) const override {
+	virtual std::string toJSONValueField() const override {
+		// Buttons do not have a value
+		return "";
+	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		writer.endElement(beginBinarySchema(writer, BinaryElementType::Button));
+	}
+
+	virtual std::optional<Value> getValue(const std::vector<std::string>& path) const override {
 		if (!this->isValidPath(path))
-			return nullptr;
+			return {};
 
-		return std::make_unique<BooleanValueWrapper>(false);
+		return getElementValue();
 	}
 
-	virtual bool setValue(const std::vector<std::string>& path, const AValueWrapper& newValue) override {
-		if (!this->isValidPath(path) || !triggerHandler)
+	virtual bool setValue(const std::vector<std::string>& path, const Value& newValue) override {
+		if (!this->isValidPath(path))
+			return false;
+
+		return setElementValue(newValue);
+	}
+
+	virtual std::optional<Value> getElementValue() const override {
+		return Value(false);
+	}
+
+	virtual bool setElementValue(const Value& /*newValue*/) override {
+		if (!triggerHandler)
 			return false;
 
 		triggerHandler->onTrigger();
@@ -382,11 +690,21 @@ struct NumberFieldInt32Element : public AControlElementWithParentAndValue<IInt32
 		return "numberfield_int32";
 	}
 
-	virtual std::string toJSON() const override {
-		return jsonPrefix() + ","_s + jsonValueField(dataHandler ? dataHandler->getValue() : 0) + "}"_s;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		appendJSONTemplateWithValue(target, "");
+	}
+
+	virtual std::string toJSONValueField() const override {
+		return jsonValueField(dataHandler ? dataHandler->getValue() : 0);
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = beginBinarySchema(writer, BinaryElementType::NumberFieldInt32);
+		writer.writeInt32(dataHandler ? dataHandler->getValue() : 0);
+		writer.endElement(start);
+	}
+
+	virtual void setValue(const Value& newValue) override {
 		this->dataHandler->setValue(newValue.getAsInt32());
 	}
 };
@@ -401,12 +719,23 @@ struct ATextFieldElement : public AControlElementWithParentAndValue<IStringDataH
 		maxLength(maxLength),
 		config_sendValueToClient(sendValueToClient) {}
 
-	virtual std::string toJSON() const override {
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		this->appendJSONTemplateWithValue(target, ","_s + this->jsonField("maxLength", int32_t(maxLength)));
+	}
+
+	virtual std::string toJSONValueField() const override {
 		std::string value = (config_sendValueToClient && this->dataHandler) ? this->dataHandler->getValue() : "";
-		return this->jsonPrefix() + ","_s + this->jsonField("maxLength", int32_t(maxLength)) + ","_s + this->jsonValueField(value) + "}"_s;
+		return this->jsonValueField(value);
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	void appendBinarySchemaTextField(BinarySchemaWriter& writer, BinaryElementType type) const {
+		size_t start = this->beginBinarySchema(writer, type);
+		writer.writeVarUInt(maxLength);
+		writer.writeString((config_sendValueToClient && this->dataHandler) ? this->dataHandler->getValue() : "");
+		writer.endElement(start);
+	}
+
+	virtual void setValue(const Value& newValue) override {
 		this->dataHandler->setValue(newValue.getAsString());
 	}
 };
@@ -420,6 +749,10 @@ struct TextFieldElement : public ATextFieldElement<TextFieldElement> {
 		return "textfield";
 	}
 
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		appendBinarySchemaTextField(writer, BinaryElementType::TextField);
+	}
+
 	GroupElement* endTextField() {
 		return parent;
 	}
@@ -433,6 +766,10 @@ struct PasswordFieldElement : public ATextFieldElement<PasswordFieldElement> {
 		return "password";
 	}
 
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		appendBinarySchemaTextField(writer, BinaryElementType::PasswordField);
+	}
+
 	GroupElement* endPasswordField() {
 		return parent;
 	}
@@ -449,23 +786,25 @@ struct RGBWFieldElement : public AControlElementWithParentAndValue<IRGBWDataHand
 		return "RGBWRange";
 	}
 
-	virtual std::string toJSON() const override {
-		std::stringstream s;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		appendJSONTemplateWithValue(target, ","_s + jsonField("channel", channelString, true));
+	}
 
+	virtual std::string toJSONValueField() const override {
 		uint32_t rgbwPackedValue = dataHandler ? dataHandler->getValue().getAsPackedColor() : 0;
+		return jsonValueField(rgbwPackedValue);
+	}
 
-		s << jsonPrefix();
-		s << ",\"channel\":"_s;
-		s << "\"" << channelString << "\",";
-		s << jsonValueField(rgbwPackedValue);
-		s << "}"_s;
-
-		return s.str();
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = beginBinarySchema(writer, BinaryElementType::RGBWRange);
+		writer.writeString(channelString);
+		writer.writeUInt32(dataHandler ? dataHandler->getValue().getAsPackedColor() : 0);
+		writer.endElement(start);
 	}
 
-	virtual void setValue(const AValueWrapper& newValue) override {
+	virtual void setValue(const Value& newValue) override {
 		if (dataHandler) {
-			dataHandler->setValue(RGBW(newValue.getAsInt32()));
+			dataHandler->setValue(newValue.getAsRGBW());
 		}
 	}
 
@@ -486,20 +825,22 @@ struct CompassElement : public AControlElementWithParentAndValue<IDataHandler<T>
 		return "Compass";
 	}
 
-	virtual std::string toJSON() const override {
-		std::stringstream s;
-
-		T value = dataHandler ? dataHandler->getValue() : 0.f;
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		Base::appendJSONTemplateWithValue(target, "");
+	}
 
-		s << Base::jsonPrefix();
-		s << ","_s;
-		s << Base::jsonValueField(value);
-		s << "}"_s;
+	virtual std::string toJSONValueField() const override {
+		T value = dataHandler ? dataHandler->getValue() : T(0);
+		return Base::jsonValueField(value);
+	}
 
-		return s.str();
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		size_t start = Base::beginBinarySchema(writer, BinaryElementType::Compass);
+		writer.writeFloat32(dataHandler ? float(dataHandler->getValue()) : 0.f);
+		writer.endElement(start);
 	}
 
-	virtual void setValue(const AValueWrapper& /*newValue*/) override {
+	virtual void setValue(const Value& /*newValue*/) override {
 		// Compass is just an output element
 	}
 
@@ -512,10 +853,18 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
 	std::vector<std::unique_ptr<IControlElement>> elements;
 	// Controls collapsable + collapsed, not set -> not collapsable.
 	std::optional<bool> collapsed;
+	// Cached JSON template of this group, rebuilt on demand after structural changes.
+	// Read by the BLE task while the application changes flags, only accessed by std::atomic_load() / std::atomic_store().
+	mutable std::shared_ptr<const JSONTemplate> jsonTemplateCache;
+	// Incremented on every invalidation, a template build during a change is not cached
+	std::atomic<uint32_t> jsonCacheGeneration;
 
 	GroupElement(GroupElement* parent, std::string name) :
 		AControlElementWithParent(parent, name),
-		elements() {}
+		elements(),
+		collapsed(),
+		jsonTemplateCache(),
+		jsonCacheGeneration(0) {}
 
 	GroupElement* endGroup() {
 		return parent;
@@ -530,6 +879,7 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
 	 */
 	GroupElement* setCollapsed(bool collapsed = true) {
 		this->collapsed = collapsed;
+		invalidateJSONCache();
 		return this;
 	}
 
@@ -538,13 +888,84 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
 	 */
 	GroupElement* setCollapsable(bool collapsable = true) {
 		this->collapsed = collapsable ? std::optional<bool>(false) : std::optional<bool>();
+		invalidateJSONCache();
 		return this;
 	}
 
+	/**
+	 * Drops the cached JSON template of this group and all parent groups.
+	 * Must be called after modifying structural members (e.g. min/max of a range) directly.
+	 */
+	void invalidateJSONCache() {
+		jsonCacheGeneration++;
+		std::atomic_store(&jsonTemplateCache, std::shared_ptr<const JSONTemplate>());
+
+		if (parent) {
+			parent->invalidateJSONCache();
+		}
+	}
+
+	virtual void onStructureChanged() override {
+		invalidateJSONCache();
+	}
+
+	/**
+	 * \return the JSON template of this group, build on demand and cached until the next structural change.
+	 */
+	std::shared_ptr<const JSONTemplate> getJSONTemplate() const {
+		std::shared_ptr<const JSONTemplate> cachedTemplate = std::atomic_load(&jsonTemplateCache);
+
+		if (cachedTemplate)
+			return cachedTemplate;
+
+		uint32_t generation = jsonCacheGeneration;
+
+		std::shared_ptr<JSONTemplate> newTemplate = std::make_shared<JSONTemplate>();
+		buildJSONTemplate(*newTemplate);
+
+		if (generation == jsonCacheGeneration) {
+			std::atomic_store(&jsonTemplateCache, std::shared_ptr<const JSONTemplate>(newTemplate));
+		}
+
+		return newTemplate;
+	}
+
+	/**
+	 * \return the absolute path of this group in the string representation (comma separated).
+	 * The root element has an empty path.
+	 */
+	std::string getAbsolutePath() const {
+		if (!parent)
+			return "";
+
+		std::string parentPath = parent->getAbsolutePath();
+
+		if (parentPath.empty())
+			return name;
+
+		return parentPath + ',' + name;
+	}
+
+	/**
+	 * Called for every element added somewhere below this group.
+	 * Forwards the element up to the root element, which maintains the path index.
+	 */
+	virtual void registerElement(const std::string& absolutePath, IControlElement* element) {
+		if (parent) {
+			parent->registerElement(absolutePath, element);
+		}
+	}
+
 	template <typename T>
 	T* _addElement(std::unique_ptr<T>&& element) {
 		elements.emplace_back(std::move(element));
-		return (T*)(elements.rbegin()->get());
+		T* addedElement = (T*)(elements.rbegin()->get());
+
+		std::string groupPath = getAbsolutePath();
+		registerElement(groupPath.empty() ? addedElement->getName() : groupPath + ',' + addedElement->getName(), addedElement);
+		invalidateJSONCache();
+
+		return addedElement;
 	}
 
 	GroupElement* addGroup(std::string name) {
@@ -591,34 +1012,98 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
 		return _addElement(std::make_unique<CompassElement<int32_t>>(this, name, handler));
 	}
 
-	virtual std::string toJSON() const override {
-		std::stringstream s;
-		s << jsonPrefix();
+	std::string jsonGroupPrefix() const {
+		std::string prefix = jsonPrefix();
 
 		if (collapsed) {
-			s << "," << jsonField("collapsed", *collapsed);
+			prefix += "," + jsonField("collapsed", *collapsed);
 		}
 
-		s << ",\"elements\":[";
+		return prefix;
+	}
+
+	void buildJSONTemplate(JSONTemplate& target) const {
+		target.appendText(jsonGroupPrefix() + ",\"elements\":[");
 
 		size_t i = 0;
 
 		for (const std::unique_ptr<IControlElement>& element : elements) {
-			s << element->toJSON();
+			element->appendJSONTemplate(target);
 
 			if (i++ < elements.size() - 1) {
-				s << ",";
+				target.appendText(",");
 			}
 		}
 
-		s << "]}";
+		target.appendText("]}");
+	}
+
+	virtual void appendJSONTemplate(JSONTemplate& target) const override {
+		target.appendTemplate(getJSONTemplate());
+	}
+
+	virtual void appendSubtreeJSONTemplate(JSONTemplate& target, uint8_t depth) const override {
+		if (depth == UNLIMITED_SUBTREE_DEPTH) {
+			appendJSONTemplate(target);
+			return;
+		}
+
+		if (depth == 0) {
+			target.appendText(jsonGroupPrefix() + ",\"lazy\":true,\"elements\":[]}");
+			return;
+		}
+
+		target.appendText(jsonGroupPrefix() + ",\"elements\":[");
+
+		size_t i = 0;
+
+		for (const std::unique_ptr<IControlElement>& element : elements) {
+			element->appendSubtreeJSONTemplate(target, depth - 1);
+
+			if (i++ < elements.size() - 1) {
+				target.appendText(",");
+			}
+		}
+
+		target.appendText("]}");
+	}
+
+	virtual std::string toJSON() const override {
+		return getJSONTemplate()->render();
+	}
+
+	virtual std::string toJSONValueField() const override {
+		// Groups do not have a value
+		return "";
+	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		uint8_t groupFlags = 0;
+
+		if (collapsed) {
+			groupFlags |= BINARY_FLAG_COLLAPSABLE;
+
+			if (*collapsed) {
+				groupFlags |= BINARY_FLAG_COLLAPSED;
+			}
+		}
+
+		size_t start = beginBinarySchema(writer, getBinaryElementType(), groupFlags);
+
+		for (const std::unique_ptr<IControlElement>& element : elements) {
+			element->appendBinarySchema(writer);
+		}
+
+		writer.endElement(start);
+	}
 
-		return s.str();
+	virtual BinaryElementType getBinaryElementType() const {
+		return BinaryElementType::Group;
 	}
 
-	virtual std::unique_ptr<AValueWrapper> getValue(const std::vector<std::string>& path) const override {
+	virtual std::optional<Value> getValue(const std::vector<std::string>& path) const override {
 		if (path.size() < 2 || path[0] != name)
-			return nullptr;
+			return {};
 
 		for (auto& element : elements) {
 			if (element->getName() == path[1]) {
@@ -626,17 +1111,26 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
 			}
 		}
 
-		return nullptr;
+		return {};
 	}
 
-	virtual bool setValue(const std::vector<std::string>& path, const AValueWrapper& newValue) override {
+	virtual bool setValue(const std::vector<std::string>& path, const Value& newValue) override {
 		if (path.size() < 2 || path[0] != name)
 			return false;
 
 		return _setValueInsideGroup({path.begin() + 1, path.end()}, newValue);
 	}
 
-	bool _setValueInsideGroup(const std::vector<std::string>& pathWithoutGroup, const AValueWrapper& newValue) {
+	virtual std::optional<Value> getElementValue() const override {
+		// Groups do not have a value
+		return {};
+	}
+
+	virtual bool setElementValue(const Value& /*newValue*/) override {
+		return false;
+	}
+
+	bool _setValueInsideGroup(const std::vector<std::string>& pathWithoutGroup, const Value& newValue) {
 		for (auto& element : elements) {
 			if (element->getName() == pathWithoutGroup[0]) {
 				return element->setValue(pathWithoutGroup, newValue);
@@ -669,29 +1163,193 @@ struct GroupElement : public AControlElementWithParent<GroupElement> {
  * Root element of the GUI structure.
  *
  * This is a special subclass of the GroupElement without a name.
+ * Maintains an index of all elements by their absolute path, updated whenever
+ * an element is added somewhere in the tree. Every added element also gets a
+ * numeric id assigned (in order of insertion), which can be used on the wire
+ * instead of the path.
  */
-struct RootElement : public GroupElement {
+struct RootElement : public GroupElement, public IGUIModel {
+	struct IndexEntry {
+		IControlElement* element;
+		std::string_view path;
+	};
+
+	// Owns the path strings, the deque keeps references stable for the index keys
+	std::deque<std::string> indexedPaths;
+	std::unordered_map<std::string_view, IControlElement*> pathIndex;
+	std::vector<IndexEntry> elementsById;
+
+	// Template the structure hash was computed from, a new template means a changed structure
+	mutable std::shared_ptr<const JSONTemplate> hashedTemplate;
+	mutable uint32_t structureHash;
+
+	std::function<void()> onValuesCommittedCallback;
+
 	RootElement() :
-		GroupElement(nullptr, "") {}
+		GroupElement(nullptr, ""),
+		indexedPaths(),
+		pathIndex(),
+		elementsById(),
+		hashedTemplate(),
+		structureHash(0),
+		onValuesCommittedCallback() {}
+
+	/**
+	 * Sets the callback invoked once after a client changed several values at once (transaction).
+	 * The data handlers of the single elements are invoked before, the callback can apply the combined state.
+	 */
+	void setOnValuesCommittedCallback(std::function<void()> callback) {
+		onValuesCommittedCallback = callback;
+	}
+
+	virtual void registerElement(const std::string& absolutePath, IControlElement* element) override {
+		const std::string& storedPath = indexedPaths.emplace_back(absolutePath);
+
+		if (elementsById.size() < INVALID_ELEMENT_ID) {
+			element->setElementId(elementsById.size());
+			elementsById.push_back({element, storedPath});
+		}
+
+		// Keep the first element on duplicated names, same as the linear search
+		pathIndex.emplace(storedPath, element);
+	}
+
+	/**
+	 * \return the element with the given id or nullptr when the id is unknown.
+	 */
+	IControlElement* findElementById(uint16_t id) const {
+		if (id >= elementsById.size())
+			return nullptr;
+
+		return elementsById[id].element;
+	}
+
+	/**
+	 * \return the absolute path (comma separated) of the element with the given id,
+	 * empty when the id is unknown.
+	 */
+	virtual std::string_view getElementPath(uint16_t id) const override {
+		if (id >= elementsById.size())
+			return {};
+
+		return elementsById[id].path;
+	}
+
+	/**
+	 * Resolves an element by its absolute path in the string representation (comma separated).
+	 * Uses the path index, does not allocate memory.
+	 * \return the element or nullptr when the path is unknown.
+	 */
+	IControlElement* findElement(std::string_view absolutePath) const {
+		auto iter = pathIndex.find(absolutePath);
+
+		if (iter == pathIndex.end())
+			return nullptr;
+
+		return iter->second;
+	}
+
+	virtual uint16_t getElementCount() const override {
+		return elementsById.size();
+	}
+
+	virtual uint16_t findElementId(std::string_view absolutePath) const override {
+		IControlElement* element = findElement(absolutePath);
+		return element ? element->getElementId() : INVALID_ELEMENT_ID;
+	}
+
+	virtual std::optional<Value> getElementValueById(uint16_t id) const override {
+		IControlElement* element = findElementById(id);
+		return element ? element->getElementValue() : std::nullopt;
+	}
+
+	virtual bool setElementValueById(uint16_t id, const Value& newValue) override {
+		IControlElement* element = findElementById(id);
+		return element ? element->setElementValue(newValue) : false;
+	}
+
+	virtual void notifyValuesCommitted() override {
+		if (onValuesCommittedCallback) {
+			onValuesCommittedCallback();
+		}
+	}
+
+	virtual bool getElementFlagById(uint16_t id, GUIFlag flag) const override {
+		IControlElement* element = findElementById(id);
+		return element ? element->getFlag(flag) : false;
+	}
+
+	virtual void setElementFlagById(uint16_t id, GUIFlag flag, bool newState) override {
+		IControlElement* element = findElementById(id);
+
+		if (element) {
+			element->setFlag(flag, newState);
+		}
+	}
+
+	virtual uint32_t getElementPublishIntervalById(uint16_t id) const override {
+		IControlElement* element = findElementById(id);
+		return element ? element->getPublishInterval() : 0;
+	}
+
+	/**
+	 * \return a hash (FNV-1a) over the GUI structure, independent of the current values.
+	 * Changes whenever elements are added or names, flags, etc. are modified.
+	 */
+	virtual uint32_t getStructureHash() const override {
+		std::shared_ptr<const JSONTemplate> currentTemplate = getJSONTemplate();
+
+		if (currentTemplate == hashedTemplate)
+			return structureHash;
+
+		hashedTemplate = currentTemplate;
+		structureHash = currentTemplate->computeStructureHash();
+
+		return structureHash;
+	}
 
 	virtual const char* getElementTypeName() const override {
 		return "root";
 	}
 
-	virtual std::unique_ptr<AValueWrapper> getValue(const std::vector<std::string>& path) const override {
-		if (path.size() < 1)
+	virtual BinaryElementType getBinaryElementType() const override {
+		return BinaryElementType::Root;
+	}
+
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const override {
+		GroupElement::appendBinarySchema(writer);
+	}
+
+	virtual std::shared_ptr<const JSONTemplate> getJSONTemplate() const override {
+		return GroupElement::getJSONTemplate();
+	}
+
+	virtual std::shared_ptr<const JSONTemplate> getSubtreeJSONTemplate(uint16_t id, uint8_t depth) const override {
+		const IControlElement* element = (id == INVALID_ELEMENT_ID) ? this : findElementById(id);
+
+		if (!element)
 			return nullptr;
 
+		std::shared_ptr<JSONTemplate> result = std::make_shared<JSONTemplate>();
+		element->appendSubtreeJSONTemplate(*result, depth);
+
+		return result;
+	}
+
+	virtual std::optional<Value> getValue(const std::vector<std::string>& path) const override {
+		if (path.size() < 1)
+			return {};
+
 		for (auto& element : elements) {
 			if (element->getName() == path[0]) {
 				return element->getValue(path);
 			}
 		}
 
-		return nullptr;
+		return {};
 	}
 
-	virtual bool setValue(const std::vector<std::string>& path, const AValueWrapper& newValue) override {
+	virtual bool setValue(const std::vector<std::string>& path, const Value& newValue) override {
 		if (path.size() < 1)
 			return false;
 
@@ -713,4 +1371,11 @@ struct RootElement : public GroupElement {
 	}
 };
 
+template <typename Derived>
+void AControlElementWithParent<Derived>::onStructureChanged() {
+	if (parent) {
+		parent->invalidateJSONCache();
+	}
+}
+
 }
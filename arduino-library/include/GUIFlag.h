@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace webgui {
 
 enum class GUIFlag : uint8_t {
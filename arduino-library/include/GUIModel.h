@@ -0,0 +1,104 @@
+#pragma once
+
+#include "GUIFlag.h"
+#include "ValueWrapper.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace webgui {
+
+struct BinarySchemaWriter;
+struct JSONTemplate;
+
+/// Element id of elements which are not (yet) part of a GUI.
+static constexpr uint16_t INVALID_ELEMENT_ID = 0xFFFF;
+
+/// Depth of a subtree with all levels, see IGUIModel::getSubtreeJSONTemplate().
+static constexpr uint8_t UNLIMITED_SUBTREE_DEPTH = 0xFF;
+
+/**
+ * \return the depth of the children of a subtree with the given depth.
+ */
+inline uint8_t GetChildSubtreeDepth(uint8_t depth) {
+	return depth == UNLIMITED_SUBTREE_DEPTH ? depth : depth - 1;
+}
+
+/**
+ * A complete GUI as seen by the protocol handler, all elements are addressed by their numeric id.
+ *
+ * Implemented by the RootElement (tree build at runtime), the FlatGUI (element table build at runtime)
+ * and the StaticGUI (definition at compile time).
+ */
+struct IGUIModel {
+	virtual ~IGUIModel() = default;
+
+	/**
+	 * \return the amount of elements, valid ids are in the range [0, count).
+	 */
+	virtual uint16_t getElementCount() const = 0;
+
+	/**
+	 * \return the id of the element with the given absolute path (comma separated),
+	 * INVALID_ELEMENT_ID when the path is unknown.
+	 */
+	virtual uint16_t findElementId(std::string_view absolutePath) const = 0;
+
+	/**
+	 * \return the absolute path (comma separated) of the element, empty when the id is unknown.
+	 */
+	virtual std::string_view getElementPath(uint16_t id) const = 0;
+
+	/**
+	 * \return the current value of the element, empty when the element has no value.
+	 */
+	virtual std::optional<Value> getElementValueById(uint16_t id) const = 0;
+
+	/**
+	 * Sets a new value and invokes the handler of the element.
+	 * \return false when the element does not accept values.
+	 */
+	virtual bool setElementValueById(uint16_t id, const Value& newValue) = 0;
+
+	/**
+	 * Called after all values of a client transaction were set, invokes the commit callback.
+	 */
+	virtual void notifyValuesCommitted() = 0;
+
+	virtual bool getElementFlagById(uint16_t id, GUIFlag flag) const = 0;
+	virtual void setElementFlagById(uint16_t id, GUIFlag flag, bool newState) = 0;
+
+	/**
+	 * \return the interval (ms) in which the value is sampled and published to the clients,
+	 * 0 when the value is only send on notifyGUIValueChange().
+	 * Values with an interval are read by the telemetry thread of the WebGUIHandler, concurrently with the application,
+	 * so their getElementValueById() must be safe to call from another thread.
+	 */
+	virtual uint32_t getElementPublishIntervalById(uint16_t id) const = 0;
+
+	/**
+	 * \return a hash over the GUI structure, independent of the current values.
+	 */
+	virtual uint32_t getStructureHash() const = 0;
+
+	/**
+	 * Writes the whole GUI in the binary schema format.
+	 */
+	virtual void appendBinarySchema(BinarySchemaWriter& writer) const = 0;
+
+	/**
+	 * \return the JSON template of the whole GUI.
+	 */
+	virtual std::shared_ptr<const JSONTemplate> getJSONTemplate() const = 0;
+
+	/**
+	 * \return the JSON template of the element (INVALID_ELEMENT_ID for the whole GUI), nullptr when the id is unknown.
+	 * Groups below the depth are placeholders without elements, marked by "lazy":true.
+	 * With a depth of 1 the template contains the direct children, the child groups are placeholders.
+	 */
+	virtual std::shared_ptr<const JSONTemplate> getSubtreeJSONTemplate(uint16_t id, uint8_t depth) const = 0;
+};
+
+}
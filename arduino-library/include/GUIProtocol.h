@@ -4,10 +4,21 @@
 #include <vector>
 #include <cstring>	// for std::memcpy()
 #include <string>
+#include <string_view>
 
 enum class GUIClientHeader : uint8_t {
 	RequestGUI = 0x00,
 	SetValue = 0x01,
+	SetValueById = 0x02,
+	RequestGUIBinary = 0x03,
+	RequestGUIHash = 0x04,
+	RequestGUIValues = 0x05,
+	SetValues = 0x06,
+	RequestTransfer = 0x07,
+	SetSubtreeVisible = 0x08,
+	RequestGUISubtree = 0x09,
+	/// Benchmark type + parameters, see GUIBenchmarkType
+	Benchmark = 0x0A,
 
 	COUNT
 };
@@ -16,10 +27,64 @@ enum class GUIServerHeader : uint8_t {
 	GUIData = 0x00,
 	UpdateValue = 0x01,
 	UpdateFlag = 0x02,
+	UpdateValueById = 0x03,
+	UpdateFlagById = 0x04,
+	GUIDataBinary = 0x05,
+	GUIHash = 0x06,
+	GUIValues = 0x07,
+	UpdateValues = 0x08,
+	UpdateValuesById = 0x09,
+	/// Chunk of a split packet (stream id + data), when packets are interleaved
+	StreamChunk = 0x0A,
+	TransferSegment = 0x0B,
+	/// Head byte followed by compact value records until the end of the notification, no request id and length
+	UpdateValuesCompact = 0x0C,
+	/// Structure hash followed by the JSON of a subtree, see RequestGUISubtree
+	GUISubtree = 0x0D,
+	/// Benchmark type followed by the echoed ping or the stream data, see GUIBenchmarkType
+	BenchmarkData = 0x0E,
+};
+
+/**
+ * Measurements of a Benchmark request, the replies are BenchmarkData packets send through the regular send queue.
+ */
+enum class GUIBenchmarkType : uint8_t {
+	/// Payload (e.g. timestamp of the client) is echoed in the Interactive queue, for round trip times
+	Ping = 0x00,
+	/// Total length (u32), send in the Bulk queue as segments filling one notification each:
+	/// offset, total length and bytes of the pattern (uint8_t(offset))
+	StreamBytes = 0x01,
+	/// Count (u32), content size (u16) and interval in ms (u16), send in the Telemetry queue as separate packets:
+	/// sequence number, count, device time (ms) and padding up to the content size
+	StreamUpdates = 0x02,
 };
 
 static constexpr uint32_t BROADCAST_REQUEST_ID = 0xFFFFFFFF;
 
+/// Capability flag in the GUIHash reply: RequestTransfer is supported
+static constexpr uint8_t GUI_CAPABILITY_RELIABLE_TRANSFER = 0x01;
+
+/// Capability flag in the GUIHash reply: RequestGUISubtree is supported, the GUI can be loaded group by group
+static constexpr uint8_t GUI_CAPABILITY_SUBTREES = 0x02;
+
+/// Capability flag in the GUIHash reply: Benchmark requests are supported
+static constexpr uint8_t GUI_CAPABILITY_BENCHMARK = 0x04;
+
+/// Header of a StreamBytes segment in front of the pattern: benchmark type, offset and total length
+static constexpr size_t BENCHMARK_SEGMENT_HEADER_SIZE = 9;
+
+/// Header of a StreamUpdates packet in front of the padding: benchmark type, sequence number, count and device time
+static constexpr size_t BENCHMARK_UPDATE_HEADER_SIZE = 13;
+
+/// Header of a TransferSegment in front of the data: offset, total length and CRC-32 of the whole transfer
+static constexpr size_t TRANSFER_SEGMENT_HEADER_SIZE = 12;
+
+/// Size of the header in front of every server packet (head byte, request id, content length)
+static constexpr size_t PACKET_HEADER_SIZE = 9;
+
+/// Flag on the value type of a compact value record: Int32 as zig-zag delta against the last compact value of the element
+static constexpr uint8_t COMPACT_VALUE_DELTA = 0x80;
+
 template <class T>
 inline T PeekData(const void* ptr) {
 	T data;
@@ -36,6 +101,14 @@ inline uint8_t PeekUInt8(const void* ptr) {
 	return PeekData<uint8_t>(ptr);
 }
 
+inline uint16_t PeekUInt16(const void* ptr) {
+	return PeekData<uint16_t>(ptr);
+}
+
+inline void PokeUInt16(void* ptr, uint16_t value) {
+	PokeData(ptr, value);
+}
+
 inline uint32_t PeekUInt32(const void* ptr) {
 	return PeekData<uint32_t>(ptr);
 }
@@ -52,4 +125,47 @@ inline void PokeFloat32(void* ptr, float value) {
 	PokeData(ptr, value);
 }
 
+/**
+ * Appends the value as unsigned LEB128 (7 bits per byte, lowest first), same format as BinarySchemaWriter::writeVarUInt().
+ */
+inline void AppendVarUInt(std::vector<uint8_t>& target, uint32_t value) {
+	while (value >= 0x80) {
+		target.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+
+	target.push_back(uint8_t(value));
+}
+
+/**
+ * \returns the size of the value in the LEB128 encoding, see AppendVarUInt().
+ */
+inline size_t GetVarUIntSize(uint32_t value) {
+	size_t size = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+/**
+ * Maps signed to unsigned values (0, -1, 1, -2, ...), so small negative values have a short LEB128 encoding.
+ */
+inline uint32_t ZigZagEncode(int32_t value) {
+	return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
 std::vector<uint8_t> StringToLengthPrefixedVector(const std::string& str);
+
+/**
+ * Appends the string with a 4 byte length prefix, same format as StringToLengthPrefixedVector().
+ */
+void AppendLengthPrefixedString(std::vector<uint8_t>& target, std::string_view str);
+
+/**
+ * \returns the CRC-32 (IEEE 802.3, as used by zlib) of the data.
+ */
+uint32_t ComputeCRC32(const uint8_t* data, size_t length);
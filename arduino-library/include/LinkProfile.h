@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Link parameters requested for a connection, see BLELedController::setLinkProfile().
+ *
+ * All profiles except Default also request the 2M PHY and the maximum data length (LE Data Length Extension),
+ * both reduce the time on air of each packet. The other side of the connection decides about the final parameters.
+ */
+enum class LinkProfile : uint8_t {
+	Default,		// Parameters of the central, nothing is requested
+	Throughput,		// Short interval, for GUI downloads and many value updates
+	LowLatency,		// Shortest interval without peripheral latency, for responsive controls
+	LowPower,		// Long interval with peripheral latency, the radio sleeps most of the time
+	Adaptive,		// LowLatency while the client writes values, LowPower when it is idle
+};
+
+/**
+ * Connection parameters of a profile, in the units of the BLE specification.
+ */
+struct LinkParameters {
+	uint16_t minInterval;			// 1.25 ms units
+	uint16_t maxInterval;			// 1.25 ms units
+	uint16_t latency;				// Connection events the peripheral may skip
+	uint16_t supervisionTimeout;	// 10 ms units, must exceed (1 + latency) * maxInterval * 2
+};
+
+/// Data length (bytes of a link layer packet) requested by the profiles, the maximum of the LE Data Length Extension.
+static constexpr uint16_t LINK_PROFILE_DATA_LENGTH = 251;
+
+/// Transmit time (us) of a packet with LINK_PROFILE_DATA_LENGTH bytes on the 1M PHY.
+static constexpr uint16_t LINK_PROFILE_DATA_TIME = 2120;
+
+/**
+ * \returns the connection parameters of the profile, the ones of LowLatency for the Adaptive profile.
+ * Not used for the Default profile.
+ */
+constexpr LinkParameters GetLinkParameters(LinkProfile profile) {
+	switch (profile) {
+		case LinkProfile::Throughput:
+			return {12, 24, 0, 400};	// 15 - 30 ms
+		case LinkProfile::LowPower:
+			return {80, 160, 4, 600};	// 100 - 200 ms, up to 1 s between events
+		case LinkProfile::Default:
+		case LinkProfile::LowLatency:
+		case LinkProfile::Adaptive:
+			break;
+	}
+
+	return {6, 12, 0, 400};	// 7.5 - 15 ms
+}
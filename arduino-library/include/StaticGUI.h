@@ -0,0 +1,479 @@
+#pragma once
+
+#include "ElementTableGUI.h"
+
+#include <array>
+#include <string_view>
+#include <type_traits>
+
+namespace webgui {
+
+/**
+ * Element of a GUI definition created at compile time, see StaticGUI.
+ * All strings must have static storage duration (string literals, constexpr arrays).
+ */
+struct StaticElementRecord {
+	BinaryElementType type;
+	uint8_t flags;				// Initial BINARY_FLAG_* values
+	uint16_t parent;			// Index of the parent group, INVALID_ELEMENT_ID for top level elements
+	uint16_t subtreeSize;		// Amount of records of this element and all child elements
+	const char* name;
+	int32_t min;
+	int32_t max;
+	const char* const* items;
+	uint16_t itemCount;
+	uint16_t maxLength;
+	const char* channel;
+	uint32_t publishInterval;	// Interval (ms) of the periodic value publishing, 0 when disabled
+};
+
+/**
+ * Element (including all child elements) of a GUI definition, the records are stored in depth first order.
+ * Created by the functions in the webgui::gui namespace.
+ */
+template <size_t N>
+struct StaticElementList {
+	std::array<StaticElementRecord, N> records;
+
+	constexpr StaticElementList setAdvanced(bool advanced = true) const {
+		return withFlag(BINARY_FLAG_ADVANCED, advanced);
+	}
+
+	constexpr StaticElementList setReadOnly(bool readOnly = true) const {
+		return withFlag(BINARY_FLAG_READ_ONLY, readOnly);
+	}
+
+	/**
+	 * Enables the collapsed feature + set the collapsed state, only used by groups.
+	 */
+	constexpr StaticElementList setCollapsed(bool collapsed = true) const {
+		return withFlag(BINARY_FLAG_COLLAPSABLE, true).withFlag(BINARY_FLAG_COLLAPSED, collapsed);
+	}
+
+	/**
+	 * Enables or disables the collapsed feature, only used by groups.
+	 */
+	constexpr StaticElementList setCollapsable(bool collapsable = true) const {
+		return withFlag(BINARY_FLAG_COLLAPSABLE, collapsable).withFlag(BINARY_FLAG_COLLAPSED, false);
+	}
+
+	/**
+	 * Publishes the value periodically, at most once per interval and only when it changed.
+	 * The value is read from the telemetry thread, see IGUIModel::getElementPublishIntervalById().
+	 */
+	constexpr StaticElementList setPublishInterval(uint32_t intervalMs) const {
+		StaticElementList result = *this;
+		result.records[0].publishInterval = intervalMs;
+		return result;
+	}
+
+	constexpr StaticElementList withFlag(uint8_t flag, bool state) const {
+		StaticElementList result = *this;
+		result.records[0].flags = state ? (result.records[0].flags | flag) : (result.records[0].flags & ~flag);
+		return result;
+	}
+};
+
+/**
+ * Complete GUI definition created at compile time, the element ids are the indices of the records.
+ * Created by webgui::gui::Root().
+ */
+template <size_t N>
+struct StaticGUIDefinition {
+	static constexpr size_t ElementCount = N;
+
+	std::array<StaticElementRecord, N> records;
+
+	/**
+	 * \return the id of the element with the given absolute path (comma separated),
+	 * INVALID_ELEMENT_ID when the path is unknown. Intended for compile time usage.
+	 */
+	constexpr uint16_t findElementId(std::string_view absolutePath) const {
+		for (size_t i = 0; i < N; ++i) {
+			if (matchesPath(i, absolutePath))
+				return i;
+		}
+
+		return INVALID_ELEMENT_ID;
+	}
+
+	constexpr bool matchesPath(size_t index, std::string_view absolutePath) const {
+		const StaticElementRecord& record = records[index];
+		std::string_view name(record.name);
+
+		if (absolutePath.size() < name.size() || absolutePath.substr(absolutePath.size() - name.size()) != name)
+			return false;
+
+		absolutePath.remove_suffix(name.size());
+
+		if (record.parent == INVALID_ELEMENT_ID)
+			return absolutePath.empty();
+
+		if (absolutePath.empty() || absolutePath.back() != ',')
+			return false;
+
+		absolutePath.remove_suffix(1);
+		return matchesPath(record.parent, absolutePath);
+	}
+};
+
+namespace detail {
+
+/**
+ * Element table compiled from a StaticGUIDefinition, see ElementTableGUI.
+ */
+template <size_t Count, size_t PoolSize>
+struct StaticElementTable {
+	std::array<ElementTableRecord, Count> records;
+	std::array<char, PoolSize> pool;
+	std::array<uint16_t, Count> sortedIds;
+
+	constexpr std::string_view getPath(size_t id) const {
+		return std::string_view(pool.data() + records[id].pathOffset, records[id].pathLength);
+	}
+};
+
+constexpr size_t GetStaticStringLength(const char* str) {
+	return std::string_view(str).size();
+}
+
+template <size_t N>
+constexpr size_t GetStaticPathLength(const std::array<StaticElementRecord, N>& records, size_t index) {
+	size_t length = GetStaticStringLength(records[index].name);
+
+	if (records[index].parent != INVALID_ELEMENT_ID) {
+		length += 1 + GetStaticPathLength(records, records[index].parent);
+	}
+
+	return length;
+}
+
+/**
+ * \return the size of the string pool: The paths, the zero terminated items and channel strings.
+ */
+template <size_t N>
+constexpr size_t GetStaticPoolSize(const std::array<StaticElementRecord, N>& records) {
+	size_t size = 0;
+
+	for (size_t i = 0; i < N; ++i) {
+		size += GetStaticPathLength(records, i);
+
+		for (size_t item = 0; item < records[i].itemCount; ++item) {
+			size += GetStaticStringLength(records[i].items[item]) + 1;
+		}
+
+		if (records[i].channel) {
+			size += GetStaticStringLength(records[i].channel) + 1;
+		}
+	}
+
+	return size;
+}
+
+template <size_t PoolSize, size_t N>
+constexpr void AppendStaticString(StaticElementTable<N, PoolSize>& table, size_t& offset, const char* str) {
+	for (const char* c = str; *c; ++c) {
+		table.pool[offset++] = *c;
+	}
+
+	table.pool[offset++] = '\0';
+}
+
+template <size_t PoolSize, size_t N>
+constexpr StaticElementTable<N, PoolSize> BuildStaticElementTable(const std::array<StaticElementRecord, N>& records) {
+	StaticElementTable<N, PoolSize> table = {};
+	size_t offset = 0;
+
+	for (size_t i = 0; i < N; ++i) {
+		const StaticElementRecord& source = records[i];
+		ElementTableRecord& record = table.records[i];
+
+		record.type = source.type;
+		record.maxLength = source.maxLength;
+		record.parent = source.parent;
+		record.itemCount = source.itemCount;
+		record.min = source.min;
+		record.max = source.max;
+
+		// The records are in depth first order, the children directly follow their group
+		size_t end = i + source.subtreeSize;
+		size_t parentEnd = (source.parent == INVALID_ELEMENT_ID) ? N : source.parent + records[source.parent].subtreeSize;
+
+		record.firstChild = (source.subtreeSize > 1) ? uint16_t(i + 1) : INVALID_ELEMENT_ID;
+		record.nextSibling = (end < parentEnd) ? uint16_t(end) : INVALID_ELEMENT_ID;
+
+		// The parent is always in front of its children, so its path is already in the pool
+		record.pathOffset = offset;
+
+		if (source.parent != INVALID_ELEMENT_ID) {
+			const ElementTableRecord& parent = table.records[source.parent];
+
+			for (size_t j = 0; j < parent.pathLength; ++j) {
+				table.pool[offset++] = table.pool[parent.pathOffset + j];
+			}
+
+			table.pool[offset++] = ',';
+		}
+
+		for (const char* c = source.name; *c; ++c) {
+			table.pool[offset++] = *c;
+		}
+
+		record.pathLength = offset - record.pathOffset;
+		record.nameLength = GetStaticStringLength(source.name);
+
+		record.stringsOffset = offset;
+
+		for (size_t item = 0; item < source.itemCount; ++item) {
+			AppendStaticString(table, offset, source.items[item]);
+		}
+
+		if (source.channel) {
+			AppendStaticString(table, offset, source.channel);
+		}
+	}
+
+	// Insertion sort keeps the order of equal paths, so the lookup finds the first element (same as the RootElement)
+	for (size_t i = 0; i < N; ++i) {
+		uint16_t id = i;
+		size_t j = i;
+
+		while (j > 0 && table.getPath(id) < table.getPath(table.sortedIds[j - 1])) {
+			table.sortedIds[j] = table.sortedIds[j - 1];
+			--j;
+		}
+
+		table.sortedIds[j] = id;
+	}
+
+	return table;
+}
+
+constexpr StaticElementRecord MakeStaticRecord(BinaryElementType type, const char* name) {
+	return {type, 0, INVALID_ELEMENT_ID, 1, name, 0, 0, nullptr, 0, 0, nullptr, 0};
+}
+
+template <size_t TargetSize, size_t SourceSize>
+constexpr void AppendStaticRecords(std::array<StaticElementRecord, TargetSize>& target, size_t& offset, uint16_t parent, const std::array<StaticElementRecord, SourceSize>& source) {
+	for (size_t i = 0; i < SourceSize; ++i) {
+		StaticElementRecord record = source[i];
+		record.parent = (record.parent == INVALID_ELEMENT_ID) ? parent : uint16_t(record.parent + offset);
+		target[offset + i] = record;
+	}
+
+	offset += SourceSize;
+}
+
+}
+
+/**
+ * Functions to define a GUI at compile time, the counterpart of the GroupElement::addX() functions.
+ *
+ *  static constexpr const char* MODES[] = {"Static", "Fade"};
+ *  static constexpr auto GUI_DEFINITION = webgui::gui::Root(
+ *      webgui::gui::Group("Light",
+ *          webgui::gui::Range("Brightness", 0, 255),
+ *          webgui::gui::DropDown("Mode", MODES)
+ *      ).setCollapsed(false),
+ *      webgui::gui::Button("Reset")
+ *  );
+ */
+namespace gui {
+
+template <size_t... Sizes>
+constexpr StaticGUIDefinition<(Sizes + ... + 0)> Root(const StaticElementList<Sizes>&... elements) {
+	StaticGUIDefinition<(Sizes + ... + 0)> result = {};
+	[[maybe_unused]] size_t offset = 0;
+	(detail::AppendStaticRecords(result.records, offset, INVALID_ELEMENT_ID, elements.records), ...);
+	return result;
+}
+
+template <size_t... Sizes>
+constexpr StaticElementList<1 + (Sizes + ... + 0)> Group(const char* name, const StaticElementList<Sizes>&... elements) {
+	StaticElementList<1 + (Sizes + ... + 0)> result = {};
+	result.records[0] = detail::MakeStaticRecord(BinaryElementType::Group, name);
+	result.records[0].subtreeSize = 1 + (Sizes + ... + 0);
+
+	[[maybe_unused]] size_t offset = 1;
+	(detail::AppendStaticRecords(result.records, offset, 0, elements.records), ...);
+	return result;
+}
+
+constexpr StaticElementList<1> Range(const char* name, int32_t min, int32_t max) {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::Range, name);
+	record.min = min;
+	record.max = max;
+	return {{record}};
+}
+
+constexpr StaticElementList<1> Checkbox(const char* name) {
+	return {{detail::MakeStaticRecord(BinaryElementType::Checkbox, name)}};
+}
+
+template <size_t ItemCount>
+constexpr StaticElementList<1> Radio(const char* name, const char* const (&items)[ItemCount]) {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::Radio, name);
+	record.items = items;
+	record.itemCount = ItemCount;
+	return {{record}};
+}
+
+template <size_t ItemCount>
+constexpr StaticElementList<1> DropDown(const char* name, const char* const (&items)[ItemCount]) {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::DropDown, name);
+	record.items = items;
+	record.itemCount = ItemCount;
+	return {{record}};
+}
+
+constexpr StaticElementList<1> Button(const char* name) {
+	return {{detail::MakeStaticRecord(BinaryElementType::Button, name)}};
+}
+
+constexpr StaticElementList<1> NumberFieldInt32(const char* name) {
+	return {{detail::MakeStaticRecord(BinaryElementType::NumberFieldInt32, name)}};
+}
+
+constexpr StaticElementList<1> TextField(const char* name, uint16_t maxLength) {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::TextField, name);
+	record.maxLength = maxLength;
+	return {{record}};
+}
+
+constexpr StaticElementList<1> PasswordField(const char* name, uint16_t maxLength) {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::PasswordField, name);
+	record.maxLength = maxLength;
+	return {{record}};
+}
+
+constexpr StaticElementList<1> RGBWRange(const char* name, const char* channelString = "RGBW") {
+	StaticElementRecord record = detail::MakeStaticRecord(BinaryElementType::RGBWRange, name);
+	record.channel = channelString;
+	return {{record}};
+}
+
+constexpr StaticElementList<1> Compass(const char* name) {
+	return {{detail::MakeStaticRecord(BinaryElementType::Compass, name)}};
+}
+
+}
+
+/**
+ * GUI with a structure fixed at compile time, alternative to the RootElement.
+ *
+ * The definition is compiled into an element table (records, string pool and path lookup) as constant expression,
+ * so it is placed in flash. Only the bound handlers and the flags are held in RAM, creating the GUI does not
+ * allocate any memory. The element ids are known at compile time, the handlers are bound by id:
+ *
+ *  static webgui::StaticGUI<GUI_DEFINITION> gui;
+ *  gui.bind<GUI_DEFINITION.findElementId("Light,Brightness")>(brightnessHandler);
+ *
+ * The handlers are not owned by the GUI and must stay valid as long as the GUI is used.
+ * The GUI description is generated from the table on request and matches the one of an equal RootElement.
+ */
+template <const auto& Definition>
+struct StaticGUI final : public ElementTableGUI<StaticGUI<Definition>> {
+	using DefinitionType = std::remove_cv_t<std::remove_reference_t<decltype(Definition)>>;
+
+	static constexpr size_t Count = DefinitionType::ElementCount;
+	static_assert(Count < INVALID_ELEMENT_ID, "Too many elements for the numeric element ids");
+
+	static constexpr const std::array<StaticElementRecord, Count>& Records = Definition.records;
+	static constexpr size_t PoolSize = detail::GetStaticPoolSize(Definition.records);
+	static constexpr detail::StaticElementTable<Count, PoolSize> Table = detail::BuildStaticElementTable<PoolSize>(Definition.records);
+
+	std::array<void*, Count> handlers;
+	std::array<uint8_t, Count> flags;
+
+	StaticGUI() :
+		handlers(),
+		flags() {
+
+		for (size_t i = 0; i < Count; ++i) {
+			flags[i] = Records[i].flags;
+		}
+	}
+
+	template <uint16_t Id>
+	void bind(IInt32DataHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::Range || Records[Id].type == BinaryElementType::NumberFieldInt32 || Records[Id].type == BinaryElementType::Compass,
+			"Int32 handlers are used by range, number field and compass elements");
+		handlers[Id] = &handler;
+	}
+
+	template <uint16_t Id>
+	void bind(IBoolDataHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::Checkbox, "Bool handlers are used by checkbox elements");
+		handlers[Id] = &handler;
+	}
+
+	template <uint16_t Id>
+	void bind(IUInt16DataHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::Radio || Records[Id].type == BinaryElementType::DropDown,
+			"UInt16 handlers are used by radio and drop down elements");
+		handlers[Id] = &handler;
+	}
+
+	template <uint16_t Id>
+	void bind(IStringDataHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::TextField || Records[Id].type == BinaryElementType::PasswordField,
+			"String handlers are used by text and password fields");
+		handlers[Id] = &handler;
+	}
+
+	template <uint16_t Id>
+	void bind(IRGBWDataHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::RGBWRange, "RGBW handlers are used by RGBW range elements");
+		handlers[Id] = &handler;
+	}
+
+	template <uint16_t Id>
+	void bind(ITriggerHandler& handler) {
+		static_assert(Id < Count, "Invalid element id");
+		static_assert(Records[Id].type == BinaryElementType::Button, "Trigger handlers are used by button elements");
+		handlers[Id] = &handler;
+	}
+
+	virtual uint16_t getElementCount() const override {
+		return Count;
+	}
+
+	const ElementTableRecord& getRecord(uint16_t id) const {
+		return Table.records[id];
+	}
+
+	const char* getPool() const {
+		return Table.pool.data();
+	}
+
+	const uint16_t* getSortedIds() const {
+		return Table.sortedIds.data();
+	}
+
+	uint16_t getFirstElement() const {
+		return Count > 0 ? 0 : INVALID_ELEMENT_ID;
+	}
+
+	void* getHandlerPointer(uint16_t id) const {
+		return handlers[id];
+	}
+
+	uint32_t getPublishInterval(uint16_t id) const {
+		return Records[id].publishInterval;
+	}
+
+	uint8_t getFlags(uint16_t id) const {
+		return flags[id];
+	}
+
+	void setFlags(uint16_t id, uint8_t newFlags) {
+		flags[id] = newFlags;
+	}
+};
+
+}
@@ -1,13 +1,13 @@
 #pragma once
 
-#include "ValueWrapper.h"
-
 #include <RGBW.h>
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <sstream>
-#include <memory>
+#include <utility>
+#include <variant>
 
 namespace webgui {
 
@@ -19,172 +19,169 @@ enum class ValueType : uint8_t {
 	Float32 = 4,
 };
 
-struct AValueWrapper {
-	virtual ~AValueWrapper() = default;
-
-	virtual ValueType getType() const = 0;
-
-	virtual std::string getAsString() const = 0;
-	virtual int32_t getAsInt32() const = 0;
-	virtual float getAsFloat32() const = 0;
-	virtual bool getAsBool() const = 0;
-};
-
-struct BooleanValueWrapper : public AValueWrapper {
-	bool value;
-
-	BooleanValueWrapper(bool value) :
-		value(value) {}
-
-	virtual ValueType getType() const override {
-		return ValueType::Boolean;
-	}
+/**
+ * Value of a GUI element, passed by value.
+ *
+ * The numeric types are stored inline, so reading and publishing them does not allocate any memory.
+ * Only string values own heap memory.
+ */
+struct Value {
+	// The alternatives are in the order of the ValueType enum, the index is the type
+	typedef std::variant<int32_t, std::string, bool, RGBW, float> Storage;
+
+	Storage storage;
+
+	explicit Value(int32_t value) :
+		storage(std::in_place_index<size_t(ValueType::Int32)>, value) {}
+
+	explicit Value(const std::string& value) :
+		storage(std::in_place_index<size_t(ValueType::String)>, value) {}
+
+	explicit Value(std::string&& value) :
+		storage(std::in_place_index<size_t(ValueType::String)>, std::move(value)) {}
+
+	explicit Value(std::string_view value) :
+		storage(std::in_place_index<size_t(ValueType::String)>, value) {}
+
+	explicit Value(const char* value) :
+		storage(std::in_place_index<size_t(ValueType::String)>, value) {}
+
+	explicit Value(bool value) :
+		storage(std::in_place_index<size_t(ValueType::Boolean)>, value) {}
+
+	explicit Value(RGBW value) :
+		storage(std::in_place_index<size_t(ValueType::RGBWColor)>, value) {}
+
+	explicit Value(float value) :
+		storage(std::in_place_index<size_t(ValueType::Float32)>, value) {}
+
+	ValueType getType() const {
+		return ValueType(storage.index());
+	}
+
+	std::string getAsString() const {
+		switch (getType()) {
+			case ValueType::Int32: {
+				std::stringstream s;
+				s << std::get<int32_t>(storage);
+				return s.str();
+			}
+			case ValueType::String:
+				return std::get<std::string>(storage);
+			case ValueType::Boolean:
+				return std::get<bool>(storage) ? "true" : "false";
+			case ValueType::RGBWColor: {
+				const RGBW& value = std::get<RGBW>(storage);
+				std::stringstream s;
+				s << "{" << value.r << "," << value.g << "," << value.b << "," << value.w << "}";
+				return s.str();
+			}
+			case ValueType::Float32: {
+				std::stringstream s;
+				s << std::get<float>(storage);
+				return s.str();
+			}
+		}
+
+		return "";
+	}
+
+	int32_t getAsInt32() const {
+		switch (getType()) {
+			case ValueType::Int32:
+				return std::get<int32_t>(storage);
+			case ValueType::String:
+				return 0;
+			case ValueType::Boolean:
+				return std::get<bool>(storage) ? 1 : 0;
+			case ValueType::RGBWColor:
+				return std::get<RGBW>(storage).getAsPackedColor();
+			case ValueType::Float32:
+				return std::get<float>(storage);
+		}
 
-	virtual std::string getAsString() const override {
-		return value ? "true" : "false";
-	}
-
-	virtual int32_t getAsInt32() const override {
-		return value ? 1 : 0;
-	}
-
-	virtual float getAsFloat32() const override {
-		return getAsInt32();
-	}
-
-	virtual bool getAsBool() const override {
-		return value;
-	}
-};
-
-struct Int32ValueWrapper : public AValueWrapper {
-	int32_t value;
-
-	Int32ValueWrapper(int32_t value) :
-		value(value) {}
-
-	virtual ValueType getType() const override {
-		return ValueType::Int32;
-	}
-
-	virtual std::string getAsString() const override {
-		std::stringstream s;
-		s << value;
-		return s.str();
-	}
-
-	virtual int32_t getAsInt32() const override {
-		return value;
-	}
-
-	virtual float getAsFloat32() const override {
-		return value;
-	}
-
-	virtual bool getAsBool() const override {
-		return value > 0;
-	}
-};
-
-struct Float32ValueWrapper : public AValueWrapper {
-	float value;
-
-	Float32ValueWrapper(float value) :
-		value(value) {}
-
-	virtual ValueType getType() const override {
-		return ValueType::Float32;
-	}
-
-	virtual std::string getAsString() const override {
-		std::stringstream s;
-		s << value;
-		return s.str();
-	}
-
-	virtual int32_t getAsInt32() const override {
-		return value;
-	}
-
-	virtual float getAsFloat32() const override {
-		return value;
-	}
-
-	virtual bool getAsBool() const override {
-		return value >= 1.f;
-	}
-};
-
-struct StringValueWrapper : public AValueWrapper {
-	std::string value;
-
-	StringValueWrapper(const std::string& value) :
-		value(value) {}
-
-	virtual ValueType getType() const override {
-		return ValueType::String;
-	}
-
-	virtual std::string getAsString() const override {
-		return value;
-	}
-
-	virtual int32_t getAsInt32() const override {
 		return 0;
 	}
 
-	virtual float getAsFloat32() const override {
+	float getAsFloat32() const {
+		switch (getType()) {
+			case ValueType::Int32:
+				return std::get<int32_t>(storage);
+			case ValueType::String:
+			case ValueType::RGBWColor:
+				return 0.f;
+			case ValueType::Boolean:
+				return std::get<bool>(storage) ? 1.f : 0.f;
+			case ValueType::Float32:
+				return std::get<float>(storage);
+		}
+
 		return 0.f;
 	}
 
-	virtual bool getAsBool() const override {
+	bool getAsBool() const {
+		switch (getType()) {
+			case ValueType::Int32:
+				return std::get<int32_t>(storage) > 0;
+			case ValueType::String:
+				return false;
+			case ValueType::Boolean:
+				return std::get<bool>(storage);
+			case ValueType::RGBWColor:
+				return std::get<RGBW>(storage) != COLOR_OFF;
+			case ValueType::Float32:
+				return std::get<float>(storage) >= 1.f;
+		}
+
 		return false;
 	}
-};
 
-struct RGBWValueWrapper : public AValueWrapper {
-	RGBW value;
+	RGBW getAsRGBW() const {
+		if (getType() == ValueType::RGBWColor)
+			return std::get<RGBW>(storage);
 
-	RGBWValueWrapper(RGBW value) :
-		value(value) {}
-
-	virtual ValueType getType() const override {
-		return ValueType::RGBWColor;
+		return RGBW(uint32_t(getAsInt32()));
 	}
 
-	virtual std::string getAsString() const override {
-		std::stringstream s;
-		s << "{" << value.r << "," << value.g << "," << value.b << "," << value.w << "}";
-		return s.str();
-	}
+	bool operator==(const Value& other) const {
+		if (getType() != other.getType())
+			return false;
 
-	virtual int32_t getAsInt32() const override {
-		return value.getAsPackedColor();
-	}
+		switch (getType()) {
+			case ValueType::Int32:
+				return std::get<int32_t>(storage) == std::get<int32_t>(other.storage);
+			case ValueType::String:
+				return std::get<std::string>(storage) == std::get<std::string>(other.storage);
+			case ValueType::Boolean:
+				return std::get<bool>(storage) == std::get<bool>(other.storage);
+			case ValueType::RGBWColor:
+				return std::get<RGBW>(storage).getAsPackedColor() == std::get<RGBW>(other.storage).getAsPackedColor();
+			case ValueType::Float32:
+				return std::get<float>(storage) == std::get<float>(other.storage);
+		}
 
-	virtual float getAsFloat32() const override {
-		return 0.f;
+		return false;
 	}
 
-	virtual bool getAsBool() const override {
-		return value != COLOR_OFF;
+	bool operator!=(const Value& other) const {
+		return !(*this == other);
 	}
 };
 
 template <typename ValueType>
-inline std::unique_ptr<AValueWrapper> WrapValue(const ValueType& value) {
+inline Value WrapValue(const ValueType& value) {
 	if constexpr(std::is_same<ValueType, int32_t>::value) {
-		return std::make_unique<Int32ValueWrapper>(value);
+		return Value(value);
 	} else if constexpr(std::is_same<ValueType, uint16_t>::value) {
-		return std::make_unique<Int32ValueWrapper>(value);
+		return Value(int32_t(value));
 	} else if constexpr(std::is_same<ValueType, std::string>::value) {
-		return std::make_unique<StringValueWrapper>(value);
+		return Value(value);
 	} else if constexpr(std::is_same<ValueType, bool>::value) {
-		return std::make_unique<BooleanValueWrapper>(value);
+		return Value(value);
 	} else if constexpr(std::is_same<ValueType, RGBW>::value) {
-		return std::make_unique<RGBWValueWrapper>(value);
+		return Value(value);
 	} else if constexpr(std::is_same<ValueType, float>::value) {
-		return std::make_unique<Float32ValueWrapper>(value);
+		return Value(value);
 	} else {
 		static_assert(sizeof(ValueType) != sizeof(ValueType), "Unhandled data type error");
 	}
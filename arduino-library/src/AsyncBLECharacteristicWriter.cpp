@@ -1,14 +1,73 @@
 #include "AsyncBLECharacteristicWriter.h"
 
-AsyncBLECharacteristicWriter::AsyncBLECharacteristicWriter(BLECharacteristic* pCharacteristic) :
-	sendQueue(),
-	subscriberHandles(),
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+/**
+ * Chunk source over a packet buffer, used for packets which are larger than the ring buffer.
+ */
+class BufferChunkSource final : public IChunkSource {
+	private:
+		// Shared by the copies of all subscribers
+		std::shared_ptr<const std::vector<uint8_t>> buffer;
+		size_t offset;
+
+	public:
+		BufferChunkSource(std::shared_ptr<const std::vector<uint8_t>> buffer) :
+			buffer(std::move(buffer)),
+			offset(0) {}
+
+		BufferChunkSource(const uint8_t* header, size_t headerLength, const uint8_t* content, size_t contentLength) :
+			buffer(),
+			offset(0) {
+
+			std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+
+			data->reserve(headerLength + contentLength);
+			data->insert(data->end(), header, header + headerLength);
+			data->insert(data->end(), content, content + contentLength);
+
+			buffer = std::move(data);
+		}
+
+		virtual size_t readChunk(uint8_t* target, size_t maxLength) override {
+			size_t length = std::min(maxLength, buffer->size() - offset);
+
+			std::memcpy(target, buffer->data() + offset, length);
+			offset += length;
+
+			return length;
+		}
+
+		virtual std::unique_ptr<IChunkSource> clone() const override {
+			return std::unique_ptr<IChunkSource>(new BufferChunkSource(buffer));
+		}
+};
+
+AsyncBLECharacteristicWriter::AsyncBLECharacteristicWriter(BLECharacteristic* pCharacteristic, size_t slotCount) :
+	queues(CreateQueues(std::max(slotCount, size_t(1)))),
+	subscribers(),
+	streamHeadByte(),
+	subscriberFilter(),
+	chunkBuffer(MAX_CHUNK_SIZE),
 	threadShouldExit(false),
 	pCharacteristic(pCharacteristic),
 	mutex(),
 	conditionVariable(),
 	thread{&AsyncBLECharacteristicWriter::ThreadFunc, this} {}
 
+std::vector<AsyncBLECharacteristicWriter::Queue> AsyncBLECharacteristicWriter::CreateQueues(size_t slotCount) {
+	std::vector<Queue> queues;
+	queues.reserve(PRIORITY_COUNT);
+
+	for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+		queues.emplace_back(slotCount);
+	}
+
+	return queues;
+}
+
 AsyncBLECharacteristicWriter::~AsyncBLECharacteristicWriter() {
 	{
 		std::unique_lock<std::mutex> l(mutex);
@@ -19,77 +78,521 @@ AsyncBLECharacteristicWriter::~AsyncBLECharacteristicWriter() {
 	thread.join();
 }
 
-void AsyncBLECharacteristicWriter::append(const uint8_t* ptr, size_t length) {
+bool AsyncBLECharacteristicWriter::append(const uint8_t* ptr, size_t length, Priority priority) {
+	return append(ptr, length, NO_COALESCE_KEY, false, priority);
+}
+
+bool AsyncBLECharacteristicWriter::append(const std::vector<uint8_t>& buffer, Priority priority) {
+	return append(buffer.data(), buffer.size(), priority);
+}
+
+bool AsyncBLECharacteristicWriter::append(const uint8_t* ptr, size_t length, uint32_t coalesceKey, bool replaceable, Priority priority,
+	uint32_t filterKey, uint16_t conHandle) {
+	if (length > MAX_CHUNK_SIZE) {
+		Serial.printf("Chunk of %u bytes exceeds the maximum size of %u bytes, ignoring\n", length, MAX_CHUNK_SIZE);
+		return false;
+	}
+
+	return appendPacket(ptr, length, nullptr, 0, coalesceKey, replaceable, priority, filterKey, conHandle);
+}
+
+bool AsyncBLECharacteristicWriter::appendPacket(const uint8_t* header, size_t headerLength, const uint8_t* content, size_t contentLength,
+	uint32_t coalesceKey, bool replaceable, Priority priority, uint32_t filterKey, uint16_t conHandle) {
+
+	size_t length = headerLength + contentLength;
+	Queue& queue = queues[size_t(priority)];
+	size_t slotCount = std::max(size_t(1), (length + MAX_CHUNK_SIZE - 1) / MAX_CHUNK_SIZE);
+
+	if (slotCount > queue.slots.size()) {
+		return appendSource(std::make_unique<BufferChunkSource>(header, headerLength, content, contentLength), priority, conHandle);
+	}
+
 	std::unique_lock<std::mutex> lock(mutex);
 
-	std::vector<uint8_t> buffer(length, 0);
-	memcpy(buffer.data(), ptr, length);
+	replaceable &= (slotCount == 1) && (conHandle == ALL_SUBSCRIBERS);
+
+	if (replaceable && coalesceKey != NO_COALESCE_KEY
+		&& replacePendingChunk(size_t(priority), header, headerLength, content, contentLength, coalesceKey, filterKey))
+		return true;
+
+	std::optional<size_t> firstIndex = getFreeSlots(queue, slotCount);
+
+	if (!firstIndex)
+		return false;
+
+	// Fill the slots directly from header and content
+	for (size_t slotNumber = 0; slotNumber < slotCount; ++slotNumber) {
+		size_t index = (*firstIndex + slotNumber) % queue.slots.size();
+		size_t slotOffset = slotNumber * MAX_CHUNK_SIZE;
+		size_t slotLength = std::min(MAX_CHUNK_SIZE, length - slotOffset);
+
+		CopyPacketPart(queue.getSlotBuffer(index), slotOffset, slotLength, header, headerLength, content);
 
-	sendQueue.emplace(std::move(buffer));
+		Slot& slot = queue.slots[index];
+		slot.length = slotLength;
+		slot.packetLength = (slotNumber == 0) ? length : 0;
+		slot.coalesceKey = (slotNumber == 0) ? coalesceKey : NO_COALESCE_KEY;
+		slot.filterKey = (slotNumber == 0) ? filterKey : NO_FILTER_KEY;
+		slot.conHandle = (slotNumber == 0) ? conHandle : ALL_SUBSCRIBERS;
+		slot.replaceable = replaceable;
+	}
+
+	queue.usedSlots += slotCount;
 	conditionVariable.notify_all();
+	return true;
+}
+
+bool AsyncBLECharacteristicWriter::appendPacket(std::vector<uint8_t>&& packet, Priority priority) {
+	size_t slotCount = (packet.size() + MAX_CHUNK_SIZE - 1) / MAX_CHUNK_SIZE;
+
+	if (slotCount <= queues[size_t(priority)].slots.size()) {
+		return appendPacket(packet.data(), 0, packet.data(), packet.size(), NO_COALESCE_KEY, false, priority);
+	}
+
+	return append(std::make_unique<BufferChunkSource>(std::make_shared<const std::vector<uint8_t>>(std::move(packet))), priority);
 }
 
-void AsyncBLECharacteristicWriter::append(const std::vector<uint8_t>& buffer) {
-	append(buffer.data(), buffer.size());
+bool AsyncBLECharacteristicWriter::append(std::unique_ptr<IChunkSource> source, Priority priority, uint16_t conHandle) {
+	return appendSource(std::move(source), priority, conHandle);
+}
+
+bool AsyncBLECharacteristicWriter::appendSource(std::unique_ptr<IChunkSource> source, Priority priority, uint16_t conHandle) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	Queue& queue = queues[size_t(priority)];
+	std::optional<size_t> index = getFreeSlots(queue, 1);
+
+	if (!index)
+		return false;
+
+	Slot& slot = queue.slots[*index];
+	slot.length = 0;
+	slot.packetLength = 0;
+	slot.source = std::move(source);
+	slot.coalesceKey = NO_COALESCE_KEY;
+	slot.filterKey = NO_FILTER_KEY;
+	slot.conHandle = conHandle;
+	slot.replaceable = false;
+
+	queue.usedSlots++;
+	conditionVariable.notify_all();
+	return true;
+}
+
+bool AsyncBLECharacteristicWriter::waitForFreeSlots(Priority priority, size_t count, uint32_t timeoutMs) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	Queue& queue = queues[size_t(priority)];
+	count = std::min(count, queue.slots.size());
+
+	return conditionVariable.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+		return (queue.slots.size() - queue.usedSlots >= count) || threadShouldExit;
+	}) && !threadShouldExit;
+}
+
+void AsyncBLECharacteristicWriter::setStreamHeader(std::optional<uint8_t> headByte) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	streamHeadByte = headByte;
+}
+
+void AsyncBLECharacteristicWriter::setSubscriberFilter(SubscriberFilter filter) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	subscriberFilter = std::move(filter);
 }
 
 void AsyncBLECharacteristicWriter::addSubscriber(uint16_t conHandle) {
 	std::unique_lock<std::mutex> lock(mutex);
 
-	subscriberHandles.insert(conHandle);
+	for (const Subscriber& subscriber : subscribers) {
+		if (subscriber.conHandle == conHandle)
+			return;
+	}
+
+	Subscriber subscriber = {};
+	subscriber.conHandle = conHandle;
+	subscriber.connectionInterval = MIN_RETRY_DELAY;
+
+	// New clients receive the chunks queued from now on
+	for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+		subscriber.cursors[priority].sentSlots = queues[priority].usedSlots;
+	}
+
+	subscribers.push_back(std::move(subscriber));
 }
 
 void AsyncBLECharacteristicWriter::removeSubscriber(uint16_t conHandle) {
 	std::unique_lock<std::mutex> lock(mutex);
 
-	subscriberHandles.erase(conHandle);
+	subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), [&](const Subscriber& subscriber) {
+		return subscriber.conHandle == conHandle;
+	}), subscribers.end());
+
+	// The slots may be send to all remaining subscribers
+	releaseSentSlots();
+}
+
+std::optional<size_t> AsyncBLECharacteristicWriter::getFreeSlots(Queue& queue, size_t count) {
+	if (queue.slots.size() - queue.usedSlots < count || threadShouldExit) {
+		Serial.printf("Send queue full, dropping packet of %u chunks\n", count);
+		return {};
+	}
+
+	return (queue.readIndex + queue.usedSlots) % queue.slots.size();
+}
+
+bool AsyncBLECharacteristicWriter::replacePendingChunk(size_t priority, const uint8_t* header, size_t headerLength, const uint8_t* content, size_t contentLength,
+	uint32_t coalesceKey, uint32_t filterKey) {
+	Queue& queue = queues[priority];
+
+	// Packets which were already (partially) send to any client must stay, the others would miss the newer packet
+	size_t firstPending = 0;
+
+	for (const Subscriber& subscriber : subscribers) {
+		const Cursor& cursor = subscriber.cursors[priority];
+		firstPending = std::max(firstPending, cursor.sentSlots + (cursor.slotOffset > 0 ? 1 : 0));
+	}
+
+	for (size_t i = queue.usedSlots; i > firstPending; --i) {
+		size_t index = (queue.readIndex + i - 1) % queue.slots.size();
+		Slot& slot = queue.slots[index];
+
+		if (slot.coalesceKey == COALESCE_BARRIER)
+			return false;
+
+		if (slot.coalesceKey != coalesceKey)
+			continue;
+
+		if (!slot.replaceable)
+			return false;
+
+		// Superseded packet which was not send yet, replace it with the latest one
+		size_t length = headerLength + contentLength;
+		CopyPacketPart(queue.getSlotBuffer(index), 0, length, header, headerLength, content);
+		slot.length = length;
+		slot.packetLength = length;
+		slot.filterKey = filterKey;
+		return true;
+	}
+
+	return false;
+}
+
+void AsyncBLECharacteristicWriter::releaseSentSlots() {
+	for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+		Queue& queue = queues[priority];
+		size_t sentSlots = queue.usedSlots;
+
+		for (const Subscriber& subscriber : subscribers) {
+			sentSlots = std::min(sentSlots, subscriber.cursors[priority].sentSlots);
+		}
+
+		if (sentSlots == 0)
+			continue;
+
+		for (size_t i = 0; i < sentSlots; ++i) {
+			queue.slots[queue.readIndex].source.reset();
+			queue.readIndex = (queue.readIndex + 1) % queue.slots.size();
+		}
+
+		queue.usedSlots -= sentSlots;
+
+		for (Subscriber& subscriber : subscribers) {
+			subscriber.cursors[priority].sentSlots -= sentSlots;
+		}
+
+		conditionVariable.notify_all();
+	}
+}
+
+void AsyncBLECharacteristicWriter::dropLaggingSubscribers() {
+	unsigned long now = millis();
+
+	for (auto iter = subscribers.begin(); iter != subscribers.end();) {
+		// Only the oldest slot of a full queue holds back the producers
+		bool holdsFullQueue = false;
+
+		for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+			const Queue& queue = queues[priority];
+			holdsFullQueue |= (queue.usedSlots == queue.slots.size()) && (iter->cursors[priority].sentSlots == 0);
+		}
+
+		if (!holdsFullQueue) {
+			iter->stalledSince.reset();
+			++iter;
+			continue;
+		}
+
+		if (!iter->stalledSince) {
+			iter->stalledSince = now;
+			++iter;
+			continue;
+		}
+
+		unsigned long intervalMs = std::chrono::duration_cast<std::chrono::milliseconds>(iter->connectionInterval).count();
+		unsigned long timeout = std::max<unsigned long>(LAGGING_SUBSCRIBER_TIMEOUT_MS, LAGGING_CONNECTION_EVENTS * intervalMs);
+
+		if (now - *iter->stalledSince < timeout) {
+			++iter;
+			continue;
+		}
+
+		Serial.printf("Client %u does not keep up with the send queue, disconnecting\n", iter->conHandle);
+
+		ble_gap_terminate(iter->conHandle, BLE_ERR_REM_USER_CONN_TERM);
+		iter = subscribers.erase(iter);
+	}
+
+	releaseSentSlots();
+}
+
+bool AsyncBLECharacteristicWriter::hasQueuedSlots() const {
+	for (const Queue& queue : queues) {
+		if (queue.usedSlots > 0)
+			return true;
+	}
+
+	return false;
+}
+
+std::optional<size_t> AsyncBLECharacteristicWriter::getNextPriority(const Subscriber& subscriber) const {
+	// Without stream header the chunks of different packets must not interleave
+	if (!streamHeadByte && subscriber.packetPriority)
+		return subscriber.packetPriority;
+
+	for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+		if (subscriber.cursors[priority].sentSlots < queues[priority].usedSlots)
+			return priority;
+	}
+
+	return {};
 }
 
 void AsyncBLECharacteristicWriter::ThreadFunc() {
 	std::unique_lock<std::mutex> lock(mutex);
 
+	std::chrono::microseconds retryDelay = MIN_RETRY_DELAY;
+
 	while (true) {
 		conditionVariable.wait(lock, [&] {
-			return (!sendQueue.empty()) || threadShouldExit;
+			return hasQueuedSlots() || threadShouldExit;
 		});
 
 		if (threadShouldExit) {
 			return;
 		}
 
-		if (!sendQueue.empty()) {
-			const std::vector<uint8_t> buffer = sendQueue.front();
-			sendQueue.pop();
+		// One chunk per subscriber and round, clients which are out of buffers are skipped
+		bool progress = false;
+		std::chrono::microseconds maxRetryDelay = MIN_RETRY_DELAY;
+
+		for (auto iter = subscribers.begin(); iter != subscribers.end();) {
+			Subscriber& subscriber = *iter;
+			std::optional<size_t> priority = getNextPriority(subscriber);
+
+			if (!priority) {
+				++iter;
+				continue;
+			}
+
+			switch (sendNextChunk(subscriber, *priority)) {
+				case SendResult::Sent:
+					// Any chunk is progress, also one of another priority than the held back queue
+					subscriber.stalledSince.reset();
+					progress = true;
+					break;
+				case SendResult::Blocked:
+					maxRetryDelay = std::max(maxRetryDelay, subscriber.connectionInterval);
+					break;
+				case SendResult::Disconnected:
+					iter = subscribers.erase(iter);
+					continue;
+			}
+
+			++iter;
+		}
+
+		releaseSentSlots();
+		dropLaggingSubscribers();
+
+		if (progress || !hasQueuedSlots()) {
+			retryDelay = MIN_RETRY_DELAY;
+			continue;
+		}
+
+		// All pending clients are out of buffers, they are freed when the controller reports completed packets
+		// at the next connection event. Back off up to one connection interval, new chunks or subscribers end the wait early.
+		conditionVariable.wait_for(lock, retryDelay);
+		retryDelay = std::min(retryDelay * 2, maxRetryDelay);
+	}
+}
+
+bool AsyncBLECharacteristicWriter::isForSubscriber(const Slot& slot, uint16_t conHandle) const {
+	if (slot.conHandle != ALL_SUBSCRIBERS && slot.conHandle != conHandle)
+		return false;
 
-			for (uint16_t conHandle : subscriberHandles) {
-				bool sendSuccess = false;
+	return slot.filterKey == NO_FILTER_KEY || !subscriberFilter || subscriberFilter(conHandle, slot.filterKey);
+}
 
-				while (!sendSuccess) {
-					os_mbuf* om;
+AsyncBLECharacteristicWriter::SendResult AsyncBLECharacteristicWriter::sendNextChunk(Subscriber& subscriber, size_t priority) {
+	Queue& queue = queues[priority];
+	Cursor& cursor = subscriber.cursors[priority];
 
-					do {
-						om = ble_hs_mbuf_from_flat(buffer.data(), buffer.size());
+	size_t index = (queue.readIndex + cursor.sentSlots) % queue.slots.size();
+	Slot& slot = queue.slots[index];
+	size_t chunkSize = GetChunkSize(subscriber.conHandle);
 
-						if (!om) {
-							// wait until BLE send queue get some space
-							lock.unlock();
-							delay(10);
-							lock.lock();
-						}
-					} while (!om);
+	if (cursor.packetRemaining == 0 && !isForSubscriber(slot, subscriber.conHandle)) {
+		// Not of interest for the client, skip all slots of the packet
+		cursor.sentSlots += std::max(size_t(1), (slot.packetLength + MAX_CHUNK_SIZE - 1) / MAX_CHUNK_SIZE);
+		return SendResult::Sent;
+	}
 
-					int txRet = ble_gatts_notify_custom(conHandle, pCharacteristic->getHandle(), om);
+	if (slot.source) {
+		// Every subscriber reads the source at its own pace, the slot stays queued until all are done
+		if (!cursor.source) {
+			cursor.source = slot.source->clone();
+			cursor.sourceChunk.resize(MAX_CHUNK_SIZE);
+			cursor.sourceChunkLength = 0;
+		}
 
-					if (txRet == 0) {
-						sendSuccess = true;
-					} else {
-						lock.unlock();
-						// wait until BLE send queue get some space
-						delay(10);
-						lock.lock();;
-					}
-				}
+		if (cursor.sourceChunkLength == 0) {
+			size_t streamHeaderSize = streamHeadByte ? STREAM_HEADER_SIZE : 0;
+			size_t chunkLength = cursor.source->readChunk(cursor.sourceChunk.data() + streamHeaderSize, chunkSize - streamHeaderSize);
+
+			if (chunkLength == 0) {
+				cursor.source.reset();
+				cursor.sentSlots++;
+				subscriber.packetPriority.reset();
+				return SendResult::Sent;
+			}
+
+			if (streamHeadByte) {
+				cursor.sourceChunk[0] = *streamHeadByte;
+				cursor.sourceChunk[1] = uint8_t(priority);
+			}
+
+			cursor.sourceChunkLength = streamHeaderSize + chunkLength;
+		}
+
+		SendResult result = sendNotification(subscriber, cursor.sourceChunk.data(), cursor.sourceChunkLength);
+
+		if (result == SendResult::Sent) {
+			cursor.sourceChunkLength = 0;
+			subscriber.packetPriority = priority;
+		}
+
+		return result;
+	}
+
+	if (cursor.packetRemaining == 0) {
+		// First chunk of the packet, only packets which are split for this connection get the stream header
+		cursor.packetRemaining = slot.packetLength;
+		cursor.framed = streamHeadByte && (slot.packetLength > chunkSize);
+	}
+
+	size_t streamHeaderSize = cursor.framed ? STREAM_HEADER_SIZE : 0;
+	size_t chunkLength = std::min(chunkSize - streamHeaderSize, cursor.packetRemaining);
+
+	// The cursor is only moved when the chunk was send
+	size_t sentSlots = cursor.sentSlots;
+	size_t slotOffset = cursor.slotOffset;
+	const uint8_t* chunkData;
+
+	if (!cursor.framed && slotOffset + chunkLength <= slot.length) {
+		// The chunk lies within the slot, NimBLE copies it from there into the mbuf
+		chunkData = queue.getSlotBuffer(index) + slotOffset;
+		slotOffset += chunkLength;
+
+		if (slotOffset == slot.length) {
+			sentSlots++;
+			slotOffset = 0;
+		}
+	} else {
+		// Collect the chunk from the slots of the packet, behind the stream header
+		if (cursor.framed) {
+			chunkBuffer[0] = *streamHeadByte;
+			chunkBuffer[1] = uint8_t(priority);
+		}
+
+		for (size_t copied = 0; copied < chunkLength;) {
+			size_t slotIndex = (queue.readIndex + sentSlots) % queue.slots.size();
+			size_t pieceLength = std::min(chunkLength - copied, queue.slots[slotIndex].length - slotOffset);
+
+			std::memcpy(chunkBuffer.data() + streamHeaderSize + copied, queue.getSlotBuffer(slotIndex) + slotOffset, pieceLength);
+			copied += pieceLength;
+			slotOffset += pieceLength;
+
+			if (slotOffset == queue.slots[slotIndex].length) {
+				sentSlots++;
+				slotOffset = 0;
 			}
 		}
+
+		chunkData = chunkBuffer.data();
 	}
+
+	SendResult result = sendNotification(subscriber, chunkData, streamHeaderSize + chunkLength);
+
+	if (result == SendResult::Sent) {
+		cursor.sentSlots = sentSlots;
+		cursor.slotOffset = slotOffset;
+		cursor.packetRemaining -= chunkLength;
+		subscriber.packetPriority = (cursor.packetRemaining > 0) ? std::optional<size_t>(priority) : std::nullopt;
+	}
+
+	return result;
+}
+
+AsyncBLECharacteristicWriter::SendResult AsyncBLECharacteristicWriter::sendNotification(Subscriber& subscriber, const uint8_t* data, size_t length) {
+	os_mbuf* om = ble_hs_mbuf_from_flat(data, length);
+
+	if (om) {
+		// The mbuf is consumed by the call, also on failure
+		int txRet = ble_gatts_notify_custom(subscriber.conHandle, pCharacteristic->getHandle(), om);
+
+		if (txRet == 0)
+			return SendResult::Sent;
+
+		if (txRet == BLE_HS_ENOTCONN)
+			return SendResult::Disconnected;
+	}
+
+	ble_gap_conn_desc desc;
+
+	if (ble_gap_conn_find(subscriber.conHandle, &desc) != 0) {
+		// Disconnected without unsubscribing
+		return SendResult::Disconnected;
+	}
+
+	// Interval in 1.25 ms units
+	subscriber.connectionInterval = std::max(std::chrono::microseconds(uint32_t(desc.conn_itvl) * 1250), MIN_RETRY_DELAY);
+
+	return SendResult::Blocked;
+}
+
+void AsyncBLECharacteristicWriter::CopyPacketPart(uint8_t* target, size_t offset, size_t length, const uint8_t* header, size_t headerLength,
+	const uint8_t* content) {
+	for (size_t written = 0; written < length;) {
+		size_t packetOffset = offset + written;
+		size_t pieceLength;
+
+		if (packetOffset < headerLength) {
+			pieceLength = std::min(length - written, headerLength - packetOffset);
+			std::memcpy(target + written, header + packetOffset, pieceLength);
+		} else {
+			pieceLength = length - written;
+			std::memcpy(target + written, content + (packetOffset - headerLength), pieceLength);
+		}
+
+		written += pieceLength;
+	}
+}
+
+size_t AsyncBLECharacteristicWriter::GetChunkSize(uint16_t conHandle) {
+	// ATT MTU - 3 bytes ATT header, the MTU is 0 (unknown) before the exchange
+	uint16_t mtu = ble_att_mtu(conHandle);
+
+	return std::clamp(size_t(std::max(mtu, uint16_t(3)) - 3), MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
 }
@@ -2,25 +2,197 @@
 
 #include <NimBLEDevice.h>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <queue>
+#include <optional>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
-#include <set>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Source of data which is generated chunk by chunk while sending.
+ */
+struct IChunkSource {
+	virtual ~IChunkSource() = default;
+
+	/**
+	 * Writes the next chunk into the given buffer.
+	 * \returns the amount of written bytes, 0 when the source is exhausted.
+	 */
+	virtual size_t readChunk(uint8_t* buffer, size_t maxLength) = 0;
+
+	/**
+	 * Creates a new source which reads the same data from the beginning, every subscriber reads its own copy.
+	 * Only called on sources which were not read yet.
+	 */
+	virtual std::unique_ptr<IChunkSource> clone() const = 0;
+};
 
 /**
  * Asynchronous BLE characteristic writer.
  * Uses its own thread to perform the async operations.
  *
- * Contains a sendQueue which can be filled with append().
- * Internally the thread will be waken and send the data to all
- * subscribed clients.
+ * There is one send queue per priority, a ring buffer of slots, each holds a packet or a part of it (MAX_CHUNK_SIZE bytes).
+ * All slot buffers are allocated once on construction, queueing and sending packets does not allocate memory.
+ * Internally the thread will be waken and send the packets from the slots to all subscribed clients,
+ * split into chunks (notifications) by the MTU of each connection.
+ *
+ * Every subscriber has its own position in the shared slots, the subscribers are served round robin
+ * (one chunk each), so a congested client does not delay the others. A slot is freed once it was send to all subscribers.
+ * Each subscriber gets the chunks of the highest priority first. Without stream header a started packet is completed
+ * before switching the priority, with stream header (setStreamHeader()) the chunks of packets with different priorities interleave.
+ *
+ * When the BLE stack is out of buffers for all pending clients, the thread waits for the next connection event
+ * (short backoff, at most one connection interval) instead of polling in fixed steps.
+ * A client which holds back a full queue without receiving any chunk for more than LAGGING_SUBSCRIBER_TIMEOUT_MS
+ * (or LAGGING_CONNECTION_EVENTS connection intervals, when longer) is disconnected, it resyncs after reconnecting
+ * instead of receiving a stream with gaps. Clients which are busy with other chunks (a long chunk source, a pinned packet
+ * of another priority) make progress and are kept.
+ *
+ * Packets with a filter key are only send to the subscribers accepted by the subscriber filter (setSubscriberFilter()),
+ * packets with a connection handle only to that subscriber.
+ *
+ * Appending never blocks, a packet which does not fit into the free slots is dropped (the append returns false).
+ * Producers which may wait call waitForFreeSlots() first, without holding locks the BLE task needs.
+ * The BLE host task must never wait: it processes the completed packets which free the buffers of the notifications.
  */
 class AsyncBLECharacteristicWriter final {
+	public:
+		/**
+		 * Priority classes of the send queues, highest first.
+		 */
+		enum class Priority : uint8_t {
+			Interactive,	// Value and flag updates, replies to small requests
+			Telemetry,		// Periodic values
+			Bulk,			// GUI description and value snapshots
+		};
+
+		static constexpr size_t PRIORITY_COUNT = 3;
+
+		/// Key of chunks which are never coalesced.
+		static constexpr uint32_t NO_COALESCE_KEY = 0xFFFFFFFF;
+
+		/// Key of chunks which are never coalesced and which no chunk of any key can be moved in front of.
+		static constexpr uint32_t COALESCE_BARRIER = 0xFFFFFFFE;
+
+		/// Filter key of packets which are send to all subscribers.
+		static constexpr uint32_t NO_FILTER_KEY = 0xFFFFFFFF;
+
+		/**
+		 * \returns false when the packet with the filter key must not be send to the client.
+		 * Called by the writer thread with the internal mutex locked, must not call the writer.
+		 */
+		typedef std::function<bool(uint16_t conHandle, uint32_t filterKey)> SubscriberFilter;
+
+		/// Connection handle of packets which are send to all subscribers.
+		static constexpr uint16_t ALL_SUBSCRIBERS = 0xFFFF;
+
+		/// Size of a slot, the largest notification payload (max. ATT MTU of 517 bytes - 3 bytes ATT header).
+		static constexpr size_t MAX_CHUNK_SIZE = 514;
+
+		/// Notification payload with the default ATT MTU (23 bytes), before the MTU was exchanged.
+		static constexpr size_t MIN_CHUNK_SIZE = 20;
+
+		/// Slots per priority
+		static constexpr size_t DEFAULT_SLOT_COUNT = 8;
+
+		/// Stream header in front of the chunks of split packets: head byte + stream id (the priority).
+		static constexpr size_t STREAM_HEADER_SIZE = 2;
+
+		/// Default time to wait for free slots, see waitForFreeSlots().
+		static constexpr uint32_t FREE_SLOT_TIMEOUT_MS = 1000;
+
+		/// First delay before retrying a notification when the BLE stack is out of buffers, doubled up to the connection interval.
+		static constexpr std::chrono::microseconds MIN_RETRY_DELAY{1000};
+
+		/// Time a subscriber may hold back a full queue without progress before it is disconnected, below FREE_SLOT_TIMEOUT_MS
+		/// so waiting producers don't drop packets.
+		static constexpr uint32_t LAGGING_SUBSCRIBER_TIMEOUT_MS = 500;
+
+		/// Connection intervals without progress before a subscriber is disconnected, for connections with long intervals.
+		static constexpr uint32_t LAGGING_CONNECTION_EVENTS = 4;
+
 	private:
-		std::queue<std::vector<uint8_t>> sendQueue;
-		std::set<uint16_t> subscriberHandles;
+		struct Slot {
+			size_t length;
+			// Length of the whole packet (continued in the following slots), set in the first slot of the packet
+			size_t packetLength;
+			// When set, the chunks are read from the source by every subscriber
+			std::unique_ptr<IChunkSource> source;
+			uint32_t coalesceKey;
+			// Set in the first slot of the packet, see SubscriberFilter
+			uint32_t filterKey;
+			// Set in the first slot of the packet, the only subscriber which receives it or ALL_SUBSCRIBERS
+			uint16_t conHandle;
+			// Can be overwritten by a newer packet with the same key
+			bool replaceable;
+		};
+
+		struct Queue {
+			std::vector<Slot> slots;
+			std::vector<uint8_t> slotBuffers;
+
+			// First queued slot and amount of queued slots
+			size_t readIndex;
+			size_t usedSlots;
+
+			Queue(size_t slotCount) :
+				slots(slotCount),
+				slotBuffers(slotCount * MAX_CHUNK_SIZE),
+				readIndex(0),
+				usedSlots(0) {}
+
+			uint8_t* getSlotBuffer(size_t index) {
+				return slotBuffers.data() + (index % slots.size()) * MAX_CHUNK_SIZE;
+			}
+		};
+
+		/**
+		 * Position of a subscriber in one queue.
+		 */
+		struct Cursor {
+			// Amount of queued slots (from the first one) which were send to the client
+			size_t sentSlots;
+			// Bytes of the next slot which were already send
+			size_t slotOffset;
+			// Remaining bytes of the partially send packet, the chunks have a stream header when framed
+			size_t packetRemaining;
+			bool framed;
+			// Own copy of the chunk source in the next slot, with the read chunk which is not send yet
+			std::unique_ptr<IChunkSource> source;
+			std::vector<uint8_t> sourceChunk;
+			size_t sourceChunkLength;
+		};
+
+		struct Subscriber {
+			uint16_t conHandle;
+			std::array<Cursor, PRIORITY_COUNT> cursors;
+			// Priority of the partially send packet, which must be completed first (without stream header)
+			std::optional<size_t> packetPriority;
+			// Last known connection interval, limits the retry delay
+			std::chrono::microseconds connectionInterval;
+			// Time (millis()) since the client holds back a full queue without a chunk being send to it
+			std::optional<unsigned long> stalledSince;
+		};
+
+		enum class SendResult {
+			Sent,
+			Blocked,	// BLE stack out of buffers, retry later
+			Disconnected,
+		};
+
+		std::vector<Queue> queues;
+		std::vector<Subscriber> subscribers;
+
+		std::optional<uint8_t> streamHeadByte;
+		SubscriberFilter subscriberFilter;
+
+		// Chunk which is currently send, when it is gathered from several slots or has a stream header. Only used by the writer thread.
+		std::vector<uint8_t> chunkBuffer;
 
 		bool threadShouldExit;
 		BLECharacteristic* pCharacteristic;
@@ -31,12 +203,124 @@ class AsyncBLECharacteristicWriter final {
 
 		void ThreadFunc();
 
+		bool hasQueuedSlots() const;
+
+		/**
+		 * \returns the priority of the next chunk for the subscriber, empty when all chunks were send.
+		 */
+		std::optional<size_t> getNextPriority(const Subscriber& subscriber) const;
+
+		/**
+		 * \returns false when the packet starting in the slot is not send to the subscriber (other target, filtered).
+		 */
+		bool isForSubscriber(const Slot& slot, uint16_t conHandle) const;
+
+		/**
+		 * Sends the next pending chunk of the given priority to the subscriber (or advances behind an exhausted chunk source).
+		 */
+		SendResult sendNextChunk(Subscriber& subscriber, size_t priority);
+
+		SendResult sendNotification(Subscriber& subscriber, const uint8_t* data, size_t length);
+
+		/**
+		 * \returns the notification payload size of the connection.
+		 */
+		static size_t GetChunkSize(uint16_t conHandle);
+
+		/**
+		 * Copies the given part (offset, length) of the packet made of header + content to the target.
+		 */
+		static void CopyPacketPart(uint8_t* target, size_t offset, size_t length, const uint8_t* header, size_t headerLength, const uint8_t* content);
+
+		/**
+		 * Frees the slots which were send to all subscribers.
+		 */
+		void releaseSentSlots();
+
+		/**
+		 * Disconnects subscribers which hold back a full queue without progress, see the class description.
+		 */
+		void dropLaggingSubscribers();
+
+		/**
+		 * \returns the index of the first of the given amount of free slots, empty (and logs the dropped packet) when the queue is too full.
+		 */
+		std::optional<size_t> getFreeSlots(Queue& queue, size_t count);
+
+		/**
+		 * Overwrites the last pending packet with the given key, when it is replaceable.
+		 * \returns false when there is no such packet.
+		 */
+		bool replacePendingChunk(size_t priority, const uint8_t* header, size_t headerLength, const uint8_t* content, size_t contentLength,
+			uint32_t coalesceKey, uint32_t filterKey);
+
+		bool appendSource(std::unique_ptr<IChunkSource> source, Priority priority, uint16_t conHandle);
+
+		static std::vector<Queue> CreateQueues(size_t slotCount);
+
 	public:
-		AsyncBLECharacteristicWriter(BLECharacteristic* pCharacteristic);
+		/**
+		 * \param slotCount amount of slots of each priority queue
+		 */
+		AsyncBLECharacteristicWriter(BLECharacteristic* pCharacteristic, size_t slotCount = DEFAULT_SLOT_COUNT);
 		~AsyncBLECharacteristicWriter();
 
-		void append(const uint8_t* ptr, size_t length);
-		void append(const std::vector<uint8_t>& buffer);
+		/**
+		 * Appends a packet of at most MAX_CHUNK_SIZE bytes.
+		 * \returns false when the packet was dropped, because the queue is full.
+		 */
+		bool append(const uint8_t* ptr, size_t length, Priority priority = Priority::Interactive);
+		bool append(const std::vector<uint8_t>& buffer, Priority priority = Priority::Interactive);
+
+		/**
+		 * Appends a packet identified by the coalesce key (latest value wins), at most MAX_CHUNK_SIZE bytes.
+		 * A replaceable packet overwrites the last pending packet with the same key (and priority) in place, when that one is replaceable too.
+		 * Not replaceable packets are always send, newer packets with the same key are queued behind them.
+		 * Packets for a single subscriber (conHandle) can't be replaceable.
+		 */
+		bool append(const uint8_t* ptr, size_t length, uint32_t coalesceKey, bool replaceable, Priority priority = Priority::Interactive,
+			uint32_t filterKey = NO_FILTER_KEY, uint16_t conHandle = ALL_SUBSCRIBERS);
+
+		/**
+		 * Appends the packet header + content, larger packets occupy several slots which are queued at once.
+		 * Only packets which fit into one slot (MAX_CHUNK_SIZE bytes) can be replaceable.
+		 * Packets which need more slots than available are copied into a chunk source, which is not filtered.
+		 */
+		bool appendPacket(const uint8_t* header, size_t headerLength, const uint8_t* content, size_t contentLength,
+			uint32_t coalesceKey = NO_COALESCE_KEY, bool replaceable = false, Priority priority = Priority::Interactive,
+			uint32_t filterKey = NO_FILTER_KEY, uint16_t conHandle = ALL_SUBSCRIBERS);
+
+		/**
+		 * Appends the complete packet (header included), packets which need more slots than available
+		 * are taken over by the chunk source without a copy.
+		 */
+		bool appendPacket(std::vector<uint8_t>&& packet, Priority priority = Priority::Interactive);
+
+		/**
+		 * Appends a source of one packet which is read by the writer thread in chunks of the MTU of each subscriber.
+		 * Each chunk is send as one notification. With a connection handle only that subscriber reads the source.
+		 */
+		bool append(std::unique_ptr<IChunkSource> source, Priority priority = Priority::Bulk, uint16_t conHandle = ALL_SUBSCRIBERS);
+
+		/**
+		 * Waits until the queue of the priority has the given amount of free slots (at most all slots), or the timeout expired.
+		 * Must not be called from the BLE host task, see the class description.
+		 * \returns false on timeout, a following append of that size may fail.
+		 */
+		bool waitForFreeSlots(Priority priority, size_t count = 1, uint32_t timeoutMs = FREE_SLOT_TIMEOUT_MS);
+
+		/**
+		 * Enables interleaving of packets with different priorities, when a head byte is given.
+		 * Every chunk of a packet which is split into several chunks (for the connection) is then prefixed with the head byte
+		 * and the stream id (the priority), packets which fit into one chunk are send unchanged.
+		 * Must be set before clients subscribe.
+		 */
+		void setStreamHeader(std::optional<uint8_t> headByte);
+
+		/**
+		 * Sets the filter which decides per subscriber whether packets with a filter key are send, empty to send all.
+		 */
+		void setSubscriberFilter(SubscriberFilter filter);
 
 		void addSubscriber(uint16_t conHandle);
 		void removeSubscriber(uint16_t conHandle);
@@ -1,6 +1,7 @@
 #include "BLEGUIClient.h"
 
 #include "BLELedController.h"
+#include "LinkParameterController.h"
 
 #include <lwip/def.h>	// for htonl()
 
@@ -8,7 +9,7 @@
 // TODO: Deduplicate, use a shared header
 static BLEUUID CHARACTERISTIC_UUID("013201e4-0873-4377-8bff-9a2389af3884");
 
-BLEGUIClient::BLEGUIClient(const BLEAddress& addr) :
+BLEGUIClient::BLEGUIClient(const BLEAddress& addr, LinkProfile profile) :
 	pClient(nullptr),
 	pRemoteCharacteristic(nullptr) {
 	// See https://github.com/h2zero/NimBLE-Arduino/blob/1.4.2/examples/NimBLE_Client/NimBLE_Client.ino
@@ -20,8 +21,13 @@ BLEGUIClient::BLEGUIClient(const BLEAddress& addr) :
 		pClient = NimBLEDevice::createClient();
 	}
 
-	// Set connection parameters for faster connection
-	pClient->setConnectionParams(12, 12, 0, 51);
+	if (profile == LinkProfile::Default) {
+		// Set connection parameters for faster connection
+		pClient->setConnectionParams(12, 12, 0, 51);
+	} else {
+		LinkParameters parameters = GetLinkParameters(profile);
+		pClient->setConnectionParams(parameters.minInterval, parameters.maxInterval, parameters.latency, parameters.supervisionTimeout);
+	}
 
 	// Set timeout to one second
 	pClient->setConnectTimeout(1);
@@ -35,6 +41,10 @@ BLEGUIClient::BLEGUIClient(const BLEAddress& addr) :
 
 	Serial.print("Connected\n");
 
+	if (profile != LinkProfile::Default) {
+		LinkParameterController::RequestPHYAndDataLength(pClient->getConnId());
+	}
+
 	BLERemoteService* remoteService = pClient->getService(BLELedController::GetServiceUUID(DeviceType::Primary));
 
 	if (remoteService == nullptr) {
@@ -8,6 +8,7 @@
 #include "GUIProtocol.h"
 
 #include "gui/WebGUIHandler.h"
+#include "LinkParameterController.h"
 
 #include <string.h>	// For memcpy()
 #include <optional>
@@ -39,7 +40,8 @@ static const BLEUUID LED_INFO_CHARACTERISTIC_UUID("013201e4-0873-4377-8bff-9a238
 static const BLEUUID GUI_CHARACTERISTIC_UUID("013201e4-0873-4377-8bff-9a2389af3884");
 
 struct BLELedController::CharacteristicCallbacks : public BLECharacteristicCallbacks {
-	virtual void onWrite(BLECharacteristic* pCharacteristic/*, esp_ble_gatts_cb_param_t* param*/) override {
+	virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) override {
+		instance->onClientActivity(desc->conn_handle);
 		instance->onCharacteristicWritten(pCharacteristic);
 	}
 } callbackHandler;
@@ -73,8 +75,12 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 	BLECharacteristic* modelNameCharacteristic;
 	BLECharacteristic* ledInfoCharacteristic;
 	std::unique_ptr<WebGUIHandler> optWebGUIHandler;
+	LinkParameterController linkParameterController;
 
 	uint8_t clientLimit;
+	bool guiUseElementIds;
+	bool guiInterleavePackets;
+	bool guiCompactTelemetry;
 
 	InternalData(uint8_t clientLimit, DeviceType deviceType) :
 		pServer(BLEDevice::createServer()),
@@ -82,7 +88,11 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 		modelNameCharacteristic(pService->createCharacteristic(MODEL_NAME_CHARACTERISTIC_UUID, NIMBLE_PROPERTY::READ)),
 		ledInfoCharacteristic(nullptr),
 		optWebGUIHandler(),
-		clientLimit(clientLimit) {
+		linkParameterController(),
+		clientLimit(clientLimit),
+		guiUseElementIds(false),
+		guiInterleavePackets(false),
+		guiCompactTelemetry(false) {
 
 		pServer->setCallbacks(this);
 	}
@@ -113,11 +123,41 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 		}
 	}
 
-	void setGUI(std::shared_ptr<webgui::RootElement> guiRoot) {
+	void setGUI(std::shared_ptr<webgui::IGUIModel> guiModel) {
 		optWebGUIHandler.reset();
 
-		if (guiRoot) {
-			optWebGUIHandler = std::make_unique<WebGUIHandler>(guiRoot, pService);
+		if (guiModel) {
+			optWebGUIHandler = std::make_unique<WebGUIHandler>(guiModel, pService);
+			optWebGUIHandler->setUseElementIds(guiUseElementIds);
+			optWebGUIHandler->setInterleavePackets(guiInterleavePackets);
+			optWebGUIHandler->setCompactTelemetry(guiCompactTelemetry);
+			optWebGUIHandler->setOnClientRequestCallback([this](uint16_t conHandle) {
+				linkParameterController.notifyActivity(conHandle);
+			});
+		}
+	}
+
+	void setGUIUseElementIds(bool enabled) {
+		guiUseElementIds = enabled;
+
+		if (optWebGUIHandler) {
+			optWebGUIHandler->setUseElementIds(enabled);
+		}
+	}
+
+	void setGUIInterleavePackets(bool enabled) {
+		guiInterleavePackets = enabled;
+
+		if (optWebGUIHandler) {
+			optWebGUIHandler->setInterleavePackets(enabled);
+		}
+	}
+
+	void setGUICompactTelemetry(bool enabled) {
+		guiCompactTelemetry = enabled;
+
+		if (optWebGUIHandler) {
+			optWebGUIHandler->setCompactTelemetry(enabled);
 		}
 	}
 
@@ -131,18 +171,12 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 
 		uint16_t maxMtu = std::numeric_limits<uint16_t>::max();
 
-		for (size_t i = 0; i < pServer->getConnectedCount(); ++i) {
-			uint16_t clientMtu = pServer->getPeerMTU(i);
-
-			printf("Client %u has a MTU of %u\n", i, clientMtu);
+		for (uint16_t conHandle : pServer->getPeerDevices()) {
+			uint16_t clientMtu = pServer->getPeerMTU(conHandle);
 
 			if (clientMtu == 0) {
-				// Override seems defect, override it ...
-				clientMtu = 128;
-
-				//if (errorLogTarget) {
-				//	errorLogTarget->printf("MTU of client %u reported as 0, overridden to 128\n", *clientMtu);
-				//}
+				// Not exchanged (yet), the default ATT MTU applies
+				clientMtu = BLE_ATT_MTU_DFLT;
 			}
 
 			maxMtu = std::min(maxMtu, clientMtu);
@@ -171,6 +205,8 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 	virtual void onConnect(BLEServer* _server, ble_gap_conn_desc* param) override {
 		clientLimit--;
 
+		linkParameterController.addConnection(param->conn_handle);
+
 		instance->OnConnect(BleMacToString(param->peer_ota_addr).c_str());
 
 		if (clientLimit > 0) {
@@ -181,6 +217,8 @@ struct BLELedController::InternalData : public BLEServerCallbacks {
 	virtual void onDisconnect(BLEServer* _server, ble_gap_conn_desc* param) override {
 		clientLimit++;
 
+		linkParameterController.removeConnection(param->conn_handle);
+
 		instance->OnDisconnect(BleMacToString(param->peer_ota_addr).c_str());
 	}
 };
@@ -265,8 +303,15 @@ void BLELedController::addRGBWCharacteristic(const std::string& name, std::funct
 	uuidToCharacteristicMap.insert({uuid, std::move(mapping)});
 }
 
-void BLELedController::setGUI(std::shared_ptr<webgui::RootElement> guiRoot) {
-	internal->setGUI(guiRoot);
+void BLELedController::setGUI(std::shared_ptr<webgui::IGUIModel> guiModel) {
+	internal->setGUI(guiModel);
+}
+
+uint16_t BLELedController::findGUIElementId(std::string_view path) const {
+	if (!internal->optWebGUIHandler)
+		return webgui::INVALID_ELEMENT_ID;
+
+	return internal->optWebGUIHandler->findElementId(path);
 }
 
 bool BLELedController::notifyGUIValueChange(const std::vector<std::string>& path) {
@@ -276,6 +321,27 @@ bool BLELedController::notifyGUIValueChange(const std::vector<std::string>& path
 	return internal->optWebGUIHandler->notifyGUIValueChange(path);
 }
 
+bool BLELedController::notifyGUIValueChange(uint16_t elementId) {
+	if (!internal->optWebGUIHandler)
+		return false;
+
+	return internal->optWebGUIHandler->notifyGUIValueChange(elementId);
+}
+
+void BLELedController::beginGUIValueBatch() {
+	if (!internal->optWebGUIHandler)
+		return;
+
+	internal->optWebGUIHandler->beginValueBatch();
+}
+
+void BLELedController::commitGUIValueBatch() {
+	if (!internal->optWebGUIHandler)
+		return;
+
+	internal->optWebGUIHandler->commitValueBatch();
+}
+
 bool BLELedController::setGUIElementFlag(const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState) {
 	if (!internal->optWebGUIHandler)
 		return false;
@@ -283,6 +349,44 @@ bool BLELedController::setGUIElementFlag(const std::vector<std::string>& path, w
 	return internal->optWebGUIHandler->setGUIElementFlag(path, flag, newState);
 }
 
+bool BLELedController::setGUIElementFlag(uint16_t elementId, webgui::GUIFlag flag, bool newState) {
+	if (!internal->optWebGUIHandler)
+		return false;
+
+	return internal->optWebGUIHandler->setGUIElementFlag(elementId, flag, newState);
+}
+
+void BLELedController::setGUIUseElementIds(bool enabled) {
+	internal->setGUIUseElementIds(enabled);
+}
+
+void BLELedController::setGUIInterleavePackets(bool enabled) {
+	internal->setGUIInterleavePackets(enabled);
+}
+
+void BLELedController::setGUICompactTelemetry(bool enabled) {
+	internal->setGUICompactTelemetry(enabled);
+}
+
+void BLELedController::setDefaultLinkProfile(LinkProfile profile) {
+	internal->linkParameterController.setDefaultProfile(profile);
+}
+
+bool BLELedController::setLinkProfile(const char* mac, LinkProfile profile) {
+	for (uint16_t conHandle : internal->pServer->getPeerDevices()) {
+		ble_gap_conn_desc desc;
+
+		if (ble_gap_conn_find(conHandle, &desc) != 0)
+			continue;
+
+		if (BleMacToString(desc.peer_ota_addr) == mac) {
+			return internal->linkParameterController.setProfile(conHandle, profile);
+		}
+	}
+
+	return false;
+}
+
 void BLELedController::setOnConnectCallback(std::function<void(const char*)> onConnectCallback) {
 	this->onConnectCallback = onConnectCallback;
 }
@@ -338,6 +442,10 @@ void BLELedController::onCharacteristicWritten(BLECharacteristic* characteristic
 	}
 }
 
+void BLELedController::onClientActivity(uint16_t conHandle) {
+	internal->linkParameterController.notifyActivity(conHandle);
+}
+
 void BLELedController::handleLedInfoRequest(BLECharacteristic& characteristic) {
 	if (characteristic.getDataLength() >= 1 && characteristic.getValue().data()[0] == 0x00) {
 		NimBLEAttValue value = characteristic.getValue();
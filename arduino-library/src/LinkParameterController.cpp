@@ -0,0 +1,167 @@
+#include "LinkParameterController.h"
+
+#include <algorithm>
+#include <chrono>
+
+LinkParameterController::LinkParameterController() :
+	defaultProfile(LinkProfile::Default),
+	connections(),
+	threadShouldExit(false),
+	mutex(),
+	conditionVariable(),
+	thread{&LinkParameterController::ThreadFunc, this} {}
+
+LinkParameterController::~LinkParameterController() {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		threadShouldExit = true;
+		conditionVariable.notify_all();
+	}
+
+	thread.join();
+}
+
+void LinkParameterController::setDefaultProfile(LinkProfile profile) {
+	std::unique_lock<std::mutex> lock(mutex);
+	defaultProfile = profile;
+}
+
+bool LinkParameterController::setProfile(uint16_t conHandle, LinkProfile profile) {
+	std::unique_lock<std::mutex> lock(mutex);
+	Connection* connection = findConnection(conHandle);
+
+	if (!connection)
+		return false;
+
+	connection->profile = profile;
+	connection->lastActivity = millis();
+	conditionVariable.notify_all();
+
+	return true;
+}
+
+void LinkParameterController::addConnection(uint16_t conHandle) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Connection handles are reused
+	connections.erase(std::remove_if(connections.begin(), connections.end(), [&](const Connection& connection) {
+		return connection.conHandle == conHandle;
+	}), connections.end());
+
+	// A new client loads the GUI first, adaptive connections start active
+	connections.push_back({conHandle, defaultProfile, {}, millis()});
+	conditionVariable.notify_all();
+}
+
+void LinkParameterController::removeConnection(uint16_t conHandle) {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	connections.erase(std::remove_if(connections.begin(), connections.end(), [&](const Connection& connection) {
+		return connection.conHandle == conHandle;
+	}), connections.end());
+}
+
+void LinkParameterController::notifyActivity(uint16_t conHandle) {
+	std::unique_lock<std::mutex> lock(mutex);
+	Connection* connection = findConnection(conHandle);
+
+	if (!connection)
+		return;
+
+	connection->lastActivity = millis();
+
+	// Only wake the thread when the parameters change, writes of an active client are frequent
+	if (connection->profile == LinkProfile::Adaptive && connection->requestedProfile != LinkProfile::LowLatency) {
+		conditionVariable.notify_all();
+	}
+}
+
+void LinkParameterController::ThreadFunc() {
+	std::vector<Request> requests;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!threadShouldExit) {
+		unsigned long now = millis();
+		std::optional<uint32_t> waitTime;
+
+		for (Connection& connection : connections) {
+			LinkProfile profile = GetEffectiveProfile(connection, now);
+
+			if (connection.requestedProfile != profile) {
+				requests.push_back({connection.conHandle, profile, connection.requestedProfile});
+				connection.requestedProfile = profile;
+			}
+
+			if (connection.profile == LinkProfile::Adaptive && profile == LinkProfile::LowLatency) {
+				uint32_t remaining = ADAPTIVE_IDLE_TIMEOUT_MS - (now - connection.lastActivity);
+				waitTime = std::min(waitTime.value_or(remaining), remaining);
+			}
+		}
+
+		if (!requests.empty()) {
+			// The BLE stack is not called with the mutex locked
+			lock.unlock();
+
+			for (const Request& request : requests) {
+				RequestConnectionParameters(request.conHandle, request.profile);
+
+				if (request.profile != LinkProfile::Default && request.previousProfile.value_or(LinkProfile::Default) == LinkProfile::Default) {
+					RequestPHYAndDataLength(request.conHandle);
+				}
+			}
+
+			requests.clear();
+			lock.lock();
+			continue;
+		}
+
+		if (waitTime) {
+			conditionVariable.wait_for(lock, std::chrono::milliseconds(*waitTime));
+		} else {
+			conditionVariable.wait(lock);
+		}
+	}
+}
+
+LinkParameterController::Connection* LinkParameterController::findConnection(uint16_t conHandle) {
+	for (Connection& connection : connections) {
+		if (connection.conHandle == conHandle)
+			return &connection;
+	}
+
+	return nullptr;
+}
+
+LinkProfile LinkParameterController::GetEffectiveProfile(const Connection& connection, unsigned long now) {
+	if (connection.profile != LinkProfile::Adaptive)
+		return connection.profile;
+
+	return (now - connection.lastActivity < ADAPTIVE_IDLE_TIMEOUT_MS) ? LinkProfile::LowLatency : LinkProfile::LowPower;
+}
+
+void LinkParameterController::RequestConnectionParameters(uint16_t conHandle, LinkProfile profile) {
+	if (profile == LinkProfile::Default)
+		return;
+
+	LinkParameters parameters = GetLinkParameters(profile);
+
+	ble_gap_upd_params updateParams = {};
+	updateParams.itvl_min = parameters.minInterval;
+	updateParams.itvl_max = parameters.maxInterval;
+	updateParams.latency = parameters.latency;
+	updateParams.supervision_timeout = parameters.supervisionTimeout;
+
+	int ret = ble_gap_update_params(conHandle, &updateParams);
+
+	if (ret != 0) {
+		Serial.printf("Connection parameter update of connection %u failed: %d\n", conHandle, ret);
+	}
+}
+
+void LinkParameterController::RequestPHYAndDataLength(uint16_t conHandle) {
+	// Chips with Bluetooth 4.2 (ESP32) do not support the 2M PHY, the request fails then
+	ble_gap_set_prefered_le_phy(conHandle, BLE_GAP_LE_PHY_2M_MASK | BLE_GAP_LE_PHY_1M_MASK,
+		BLE_GAP_LE_PHY_2M_MASK | BLE_GAP_LE_PHY_1M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+
+	ble_gap_set_data_len(conHandle, LINK_PROFILE_DATA_LENGTH, LINK_PROFILE_DATA_TIME);
+}
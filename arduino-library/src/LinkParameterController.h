@@ -0,0 +1,92 @@
+#pragma once
+
+#include "LinkProfile.h"
+
+#include <NimBLEDevice.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Requests the link parameters (connection interval, PHY, data length) of the connections by their LinkProfile.
+ * Uses its own thread, the requests are never send from the BLE callbacks.
+ *
+ * A connection with the Adaptive profile uses the LowLatency parameters while the client writes values
+ * and is relaxed to the LowPower parameters after ADAPTIVE_IDLE_TIMEOUT_MS without writes.
+ * The parameters are only requested again when the profile changes.
+ */
+class LinkParameterController final {
+	public:
+		/// Time without writes of the client before an adaptive connection switches to the LowPower parameters.
+		static constexpr uint32_t ADAPTIVE_IDLE_TIMEOUT_MS = 5000;
+
+	private:
+		struct Connection {
+			uint16_t conHandle;
+			LinkProfile profile;
+			// Profile of the last request, empty before the first one
+			std::optional<LinkProfile> requestedProfile;
+			// Time (millis()) of the last write of the client
+			unsigned long lastActivity;
+		};
+
+		struct Request {
+			uint16_t conHandle;
+			LinkProfile profile;
+			std::optional<LinkProfile> previousProfile;
+		};
+
+		LinkProfile defaultProfile;
+		std::vector<Connection> connections;
+
+		bool threadShouldExit;
+		std::mutex mutex;
+		std::condition_variable conditionVariable;
+		std::thread thread;
+
+		void ThreadFunc();
+
+		Connection* findConnection(uint16_t conHandle);
+
+		/**
+		 * \returns the profile the parameters are requested for, LowLatency or LowPower for adaptive connections.
+		 */
+		static LinkProfile GetEffectiveProfile(const Connection& connection, unsigned long now);
+
+	public:
+		LinkParameterController();
+		~LinkParameterController();
+
+		/**
+		 * Sets the profile of new connections, LinkProfile::Default by default.
+		 */
+		void setDefaultProfile(LinkProfile profile);
+
+		/**
+		 * Changes the profile of an open connection.
+		 * \returns false when the connection is unknown.
+		 */
+		bool setProfile(uint16_t conHandle, LinkProfile profile);
+
+		void addConnection(uint16_t conHandle);
+		void removeConnection(uint16_t conHandle);
+
+		/**
+		 * Called for every write of the client, switches an idle adaptive connection to the LowLatency parameters.
+		 */
+		void notifyActivity(uint16_t conHandle);
+
+		/**
+		 * Requests the connection parameters of the profile (not for LinkProfile::Default).
+		 */
+		static void RequestConnectionParameters(uint16_t conHandle, LinkProfile profile);
+
+		/**
+		 * Requests the 2M PHY and the maximum data length, failures are ignored (not supported by all controllers).
+		 */
+		static void RequestPHYAndDataLength(uint16_t conHandle);
+};
@@ -0,0 +1,51 @@
+#include "BenchmarkChunkSource.h"
+
+#include <lwip/sockets.h>	// for htonl and other
+
+// Packet header + segment header
+static constexpr size_t SEGMENT_OVERHEAD = PACKET_HEADER_SIZE + BENCHMARK_SEGMENT_HEADER_SIZE;
+
+BenchmarkChunkSource::BenchmarkChunkSource(uint32_t requestId, uint32_t length) :
+	requestId(requestId),
+	length(length),
+	offset(0),
+	done(false) {}
+
+size_t BenchmarkChunkSource::readChunk(uint8_t* buffer, size_t maxLength) {
+	if (done)
+		return 0;
+
+	if (maxLength <= SEGMENT_OVERHEAD) {
+		Serial.printf("Cannot send benchmark segment, chunk size of %u bytes too small\n", unsigned(maxLength));
+		done = true;
+		return 0;
+	}
+
+	// At least one segment is send, also for an empty stream, so the client gets the total length
+	size_t segmentLength = std::min(maxLength - SEGMENT_OVERHEAD, size_t(length - offset));
+	size_t contentLength = BENCHMARK_SEGMENT_HEADER_SIZE + segmentLength;
+
+	buffer[0] = static_cast<uint8_t>(GUIServerHeader::BenchmarkData);
+	PokeUInt32(buffer + 1, htonl(requestId));
+	PokeUInt32(buffer + 5, htonl(contentLength));
+
+	uint8_t* segment = buffer + PACKET_HEADER_SIZE;
+	segment[0] = static_cast<uint8_t>(GUIBenchmarkType::StreamBytes);
+	PokeUInt32(segment + 1, htonl(offset));
+	PokeUInt32(segment + 5, htonl(length));
+
+	uint8_t* pattern = segment + BENCHMARK_SEGMENT_HEADER_SIZE;
+
+	for (size_t i = 0; i < segmentLength; ++i) {
+		pattern[i] = uint8_t(offset + i);
+	}
+
+	offset += segmentLength;
+	done = (offset == length);
+
+	return PACKET_HEADER_SIZE + contentLength;
+}
+
+std::unique_ptr<IChunkSource> BenchmarkChunkSource::clone() const {
+	return std::make_unique<BenchmarkChunkSource>(*this);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "GUIProtocol.h"
+
+#include "AsyncBLECharacteristicWriter.h"
+
+/**
+ * Chunk source of a StreamBytes benchmark, every chunk is a complete BenchmarkData packet.
+ *
+ * The data is a generated pattern (uint8_t(offset)), so large streams need no memory.
+ * Each segment carries its offset and the total length, the client counts the missing segments by the offsets.
+ */
+class BenchmarkChunkSource final : public IChunkSource {
+	private:
+		uint32_t requestId;
+		uint32_t length;
+
+		// Read position
+		uint32_t offset;
+		bool done;
+
+	public:
+		BenchmarkChunkSource(uint32_t requestId, uint32_t length);
+
+		virtual size_t readChunk(uint8_t* buffer, size_t maxLength) override;
+
+		virtual std::unique_ptr<IChunkSource> clone() const override;
+};
@@ -10,3 +10,28 @@ std::vector<uint8_t> StringToLengthPrefixedVector(const std::string& str) {
 
 	return result;
 }
+
+void AppendLengthPrefixedString(std::vector<uint8_t>& target, std::string_view str) {
+	size_t offset = target.size();
+	target.resize(offset + 4 + str.size());
+
+	PokeUInt32(target.data() + offset, htonl(str.size()));
+	std::memcpy(target.data() + offset + 4, str.data(), str.size());
+}
+
+uint32_t ComputeCRC32(const uint8_t* data, size_t length) {
+	// Half byte table, small enough to stay in the flash cache
+	static constexpr uint32_t TABLE[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+	};
+
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < length; ++i) {
+		crc = TABLE[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+		crc = TABLE[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+	}
+
+	return ~crc;
+}
@@ -0,0 +1,113 @@
+#include "JSONChunkSource.h"
+
+#include <cstring>	// for std::memcpy()
+
+JSONChunkSource::JSONChunkSource(std::shared_ptr<const webgui::JSONTemplate> jsonTemplate) :
+	jsonTemplate(jsonTemplate),
+	header(),
+	values(),
+	contentLength(jsonTemplate->textLength),
+	headerDone(false),
+	cursorStack(),
+	valueIndex(0),
+	pieceOffset(0) {
+
+	std::shared_ptr<RenderedValues> renderedValues = std::make_shared<RenderedValues>();
+	renderedValues->ends.reserve(jsonTemplate->valueCount);
+
+	jsonTemplate->visit([](const std::string&) {}, [&](const webgui::IJSONValueSource& element) {
+		renderedValues->text += element.toJSONValueField();
+		renderedValues->ends.push_back(uint32_t(renderedValues->text.size()));
+	});
+
+	renderedValues->text.shrink_to_fit();
+	contentLength += renderedValues->text.size();
+
+	values = std::move(renderedValues);
+
+	cursorStack.push_back({jsonTemplate.get(), 0});
+}
+
+void JSONChunkSource::setHeader(std::vector<uint8_t> header) {
+	this->header = std::move(header);
+}
+
+size_t JSONChunkSource::readChunk(uint8_t* buffer, size_t maxLength) {
+	size_t written = 0;
+	std::string_view piece;
+
+	while (written < maxLength && currentPiece(piece)) {
+		size_t copySize = std::min(piece.size() - pieceOffset, maxLength - written);
+		std::memcpy(buffer + written, piece.data() + pieceOffset, copySize);
+
+		written += copySize;
+		pieceOffset += copySize;
+
+		if (pieceOffset == piece.size()) {
+			advancePiece();
+		}
+	}
+
+	return written;
+}
+
+std::unique_ptr<IChunkSource> JSONChunkSource::clone() const {
+	return std::make_unique<JSONChunkSource>(*this);
+}
+
+bool JSONChunkSource::currentPiece(std::string_view& piece) {
+	if (!headerDone) {
+		piece = {reinterpret_cast<const char*>(header.data()), header.size()};
+		return true;
+	}
+
+	while (!cursorStack.empty()) {
+		Cursor& cursor = cursorStack.back();
+
+		if (cursor.segmentIndex >= cursor.jsonTemplate->segments.size()) {
+			// End of the (sub) template, continue in the parent
+			cursorStack.pop_back();
+
+			if (!cursorStack.empty()) {
+				cursorStack.back().segmentIndex++;
+			}
+
+			continue;
+		}
+
+		const webgui::JSONTemplate::Segment& segment = cursor.jsonTemplate->segments[cursor.segmentIndex];
+
+		if (segment.subTemplate) {
+			cursorStack.push_back({segment.subTemplate.get(), 0});
+			continue;
+		}
+
+		if (segment.valueElement) {
+			uint32_t begin = (valueIndex > 0) ? values->ends[valueIndex - 1] : 0;
+			piece = std::string_view(values->text).substr(begin, values->ends[valueIndex] - begin);
+		} else {
+			piece = segment.text;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void JSONChunkSource::advancePiece() {
+	pieceOffset = 0;
+
+	if (!headerDone) {
+		headerDone = true;
+		return;
+	}
+
+	Cursor& cursor = cursorStack.back();
+
+	if (cursor.jsonTemplate->segments[cursor.segmentIndex].valueElement) {
+		valueIndex++;
+	}
+
+	cursor.segmentIndex++;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "GUIElements.h"
+
+#include "AsyncBLECharacteristicWriter.h"
+
+#include <string_view>
+
+/**
+ * Chunk source which streams a JSONTemplate, prefixed by a packet header.
+ *
+ * The value fields are rendered once on construction, so the content length is fixed and the values are a consistent snapshot.
+ * The static text is read directly from the (shared, immutable) template while sending,
+ * the complete JSON string is never build in memory.
+ *
+ * Memory of a download: the rendered value fields (their text plus 4 bytes per value, shared by all subscribers)
+ * and a cursor per nesting level. The template is the group cache of the GUI, it stays resident with or without downloads.
+ */
+class JSONChunkSource final : public IChunkSource {
+	private:
+		struct Cursor {
+			const webgui::JSONTemplate* jsonTemplate;
+			size_t segmentIndex;
+		};
+
+		/**
+		 * Value fields rendered back to back, without a string per value.
+		 */
+		struct RenderedValues {
+			std::string text;
+			// End offset of each value field in the text
+			std::vector<uint32_t> ends;
+		};
+
+		std::shared_ptr<const webgui::JSONTemplate> jsonTemplate;
+		std::vector<uint8_t> header;
+		// Shared by the copies of all subscribers
+		std::shared_ptr<const RenderedValues> values;
+		size_t contentLength;
+
+		// Read position
+		bool headerDone;
+		std::vector<Cursor> cursorStack;
+		size_t valueIndex;
+		size_t pieceOffset;
+
+		/**
+		 * Resolves the piece at the current read position.
+		 * \returns false when the end is reached.
+		 */
+		bool currentPiece(std::string_view& piece);
+		void advancePiece();
+
+	public:
+		JSONChunkSource(std::shared_ptr<const webgui::JSONTemplate> jsonTemplate);
+
+		/**
+		 * \returns the length of the rendered JSON, without the header.
+		 */
+		size_t getContentLength() const {
+			return contentLength;
+		}
+
+		/**
+		 * Sets the header which is send in front of the JSON. Must be set before reading.
+		 */
+		void setHeader(std::vector<uint8_t> header);
+
+		virtual size_t readChunk(uint8_t* buffer, size_t maxLength) override;
+
+		virtual std::unique_ptr<IChunkSource> clone() const override;
+};
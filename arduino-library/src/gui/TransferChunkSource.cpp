@@ -0,0 +1,51 @@
+#include "TransferChunkSource.h"
+
+#include <lwip/sockets.h>	// for htonl and other
+
+#include <cstring>	// for std::memcpy()
+
+// Packet header + segment header
+static constexpr size_t SEGMENT_OVERHEAD = PACKET_HEADER_SIZE + TRANSFER_SEGMENT_HEADER_SIZE;
+
+TransferChunkSource::TransferChunkSource(uint32_t requestId, std::shared_ptr<const std::vector<uint8_t>> data, uint32_t crc, size_t offset,
+	std::shared_ptr<const std::atomic<bool>> cancelled) :
+	data(data),
+	requestId(requestId),
+	crc(crc),
+	cancelled(cancelled),
+	offset(std::min(offset, data->size())),
+	done(false) {}
+
+size_t TransferChunkSource::readChunk(uint8_t* buffer, size_t maxLength) {
+	if (done || *cancelled)
+		return 0;
+
+	if (maxLength <= SEGMENT_OVERHEAD) {
+		Serial.printf("Cannot send transfer segment, chunk size of %u bytes too small\n", unsigned(maxLength));
+		done = true;
+		return 0;
+	}
+
+	// At least one segment is send, also for empty data, so the client gets the total length
+	size_t length = std::min(maxLength - SEGMENT_OVERHEAD, data->size() - offset);
+	size_t contentLength = TRANSFER_SEGMENT_HEADER_SIZE + length;
+
+	buffer[0] = static_cast<uint8_t>(GUIServerHeader::TransferSegment);
+	PokeUInt32(buffer + 1, htonl(requestId));
+	PokeUInt32(buffer + 5, htonl(contentLength));
+
+	uint8_t* segment = buffer + PACKET_HEADER_SIZE;
+	PokeUInt32(segment + 0, htonl(offset));
+	PokeUInt32(segment + 4, htonl(data->size()));
+	PokeUInt32(segment + 8, htonl(crc));
+	std::memcpy(segment + TRANSFER_SEGMENT_HEADER_SIZE, data->data() + offset, length);
+
+	offset += length;
+	done = (offset == data->size());
+
+	return PACKET_HEADER_SIZE + contentLength;
+}
+
+std::unique_ptr<IChunkSource> TransferChunkSource::clone() const {
+	return std::make_unique<TransferChunkSource>(*this);
+}
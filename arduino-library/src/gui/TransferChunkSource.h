@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GUIProtocol.h"
+
+#include "AsyncBLECharacteristicWriter.h"
+
+#include <atomic>
+
+/**
+ * Chunk source of a reliable transfer, every chunk is a complete TransferSegment packet.
+ *
+ * Each segment carries its offset in the data, the total length and the CRC-32 of the whole data.
+ * The client detects missing segments by the offsets and requests the remaining data with a new transfer
+ * starting at the first missing byte, the CRC tells whether the data changed in between.
+ * A replaced transfer is stopped by the cancel flag, after the current segment.
+ */
+class TransferChunkSource final : public IChunkSource {
+	private:
+		// Transferred data, shared by the copies of all subscribers
+		std::shared_ptr<const std::vector<uint8_t>> data;
+		uint32_t requestId;
+		uint32_t crc;
+		// Shared by the copies of all subscribers, no more segments are read once set
+		std::shared_ptr<const std::atomic<bool>> cancelled;
+
+		// Read position
+		size_t offset;
+		bool done;
+
+	public:
+		/**
+		 * \param crc CRC-32 of the whole data, see ComputeCRC32()
+		 * \param offset first byte to send, the remaining data is send
+		 */
+		TransferChunkSource(uint32_t requestId, std::shared_ptr<const std::vector<uint8_t>> data, uint32_t crc, size_t offset,
+			std::shared_ptr<const std::atomic<bool>> cancelled);
+
+		virtual size_t readChunk(uint8_t* buffer, size_t maxLength) override;
+
+		virtual std::unique_ptr<IChunkSource> clone() const override;
+};
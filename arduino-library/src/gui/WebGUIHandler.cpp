@@ -1,65 +1,265 @@
 #include "WebGUIHandler.h"
+#include "JSONChunkSource.h"
+#include "TransferChunkSource.h"
+#include "BenchmarkChunkSource.h"
 
 #include "Util.h"
 
 #include "BLELedController.h"
 
+#include <cstring>
 #include <inttypes.h>
 
 static const BLEUUID GUI_CHARACTERISTIC_UUID("013201e4-0873-4377-8bff-9a2389af3884");
 
-WebGUIHandler::WebGUIHandler(std::shared_ptr<webgui::RootElement> guiRoot, BLEService* pService) :
-	guiRoot(guiRoot),
-	guiDataSendQueue(pService->createCharacteristic(GUI_CHARACTERISTIC_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY)) {
-
+// Paths up to this length are resolved in a stack buffer, longer paths need a temporary string
+static constexpr size_t MAX_STACK_PATH_LENGTH = 128;
+
+// Initial capacity of the packet buffer, enough for updates of all numeric values with their path
+static constexpr size_t PACKET_BUFFER_RESERVE = 256;
+
+// Deltas of an element before its value is send as absolute value again, clients which missed a value resync by it
+static constexpr uint8_t COMPACT_KEYFRAME_INTERVAL = 16;
+
+// Interval to check for elements with a publish interval, when none is due earlier (e.g. elements added at runtime)
+static constexpr uint32_t TELEMETRY_RESCAN_INTERVAL_MS = 1000;
+
+// Limits of the benchmark streams, so a single request can't occupy the send queue for minutes
+static constexpr uint32_t BENCHMARK_MAX_STREAM_LENGTH = 1024 * 1024;
+static constexpr uint32_t BENCHMARK_MAX_UPDATE_COUNT = 10000;
+
+WebGUIHandler::WebGUIHandler(std::shared_ptr<webgui::IGUIModel> guiModel, BLEService* pService) :
+	guiModel(guiModel),
+	guiDataSendQueue(pService->createCharacteristic(GUI_CHARACTERISTIC_UUID, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY)),
+	onClientRequestCallback(),
+	useElementIds(false),
+	compactTelemetry(false),
+	packetMutex(),
+	packetBuffer(),
+	valueBatches(),
+	compactValueBases(),
+	compactPacketBases(),
+	bleHostTask(nullptr),
+	telemetryStates(),
+	telemetryElementIds(),
+	pendingBenchmarkStream(),
+	telemetryThreadShouldExit(false),
+	telemetryThreadStarted(false),
+	telemetryMutex(),
+	telemetryConditionVariable(),
+	telemetryThread() {
+
+	packetBuffer.reserve(PACKET_BUFFER_RESERVE);
 	guiDataSendQueue.getCharacteristic()->setCallbacks(this);
+
+	guiDataSendQueue.setSubscriberFilter([this](uint16_t conHandle, uint32_t filterKey) {
+		return isElementVisible(conHandle, filterKey);
+	});
 }
 
 WebGUIHandler::~WebGUIHandler() {
+	{
+		std::unique_lock<std::mutex> lock(telemetryMutex);
+		telemetryThreadShouldExit = true;
+		telemetryConditionVariable.notify_all();
+	}
+
+	if (telemetryThread.joinable()) {
+		telemetryThread.join();
+	}
+
+	// The filter uses the subscriptions, which are destroyed before the send queue
+	guiDataSendQueue.setSubscriberFilter(nullptr);
+
 	// TODO: Remove characteristic
 }
 
+uint16_t WebGUIHandler::findElementId(std::string_view path) const {
+	return guiModel->findElementId(path);
+}
+
+uint16_t WebGUIHandler::findElementId(const std::vector<std::string>& path) const {
+	char buffer[MAX_STACK_PATH_LENGTH];
+	size_t length = 0;
+
+	for (size_t i = 0; i < path.size(); ++i) {
+		size_t separatorLength = (i + 1 < path.size()) ? 1 : 0;
+
+		if (length + path[i].size() + separatorLength > sizeof(buffer))
+			return guiModel->findElementId(ConcatPath(path));
+
+		std::memcpy(buffer + length, path[i].data(), path[i].size());
+		length += path[i].size();
+
+		if (separatorLength) {
+			buffer[length++] = ',';
+		}
+	}
+
+	return guiModel->findElementId(std::string_view(buffer, length));
+}
+
 bool WebGUIHandler::notifyGUIValueChange(const std::vector<std::string>& path) {
-	std::unique_ptr<webgui::AValueWrapper> currentValue = guiRoot->getValue(path);
+	return notifyGUIValueChange(findElementId(path));
+}
+
+bool WebGUIHandler::notifyGUIValueChange(uint16_t elementId) {
+	if (elementId >= guiModel->getElementCount())
+		return false;
+
+	std::optional<webgui::Value> currentValue = guiModel->getElementValueById(elementId);
 
 	if (!currentValue)
 		return false;
 
-	writeGUIUpdateValue(BROADCAST_REQUEST_ID, path, *currentValue);
+	if (guiModel->getElementPublishIntervalById(elementId) > 0) {
+		// Rate limited, the telemetry thread sends the latest value when the element is due
+		startTelemetryThread();
+		return true;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(packetMutex);
+
+		if (ValueBatch* batch = findValueBatch()) {
+			// The value is read when the batch is committed
+			if (std::find(batch->elementIds.begin(), batch->elementIds.end(), elementId) == batch->elementIds.end()) {
+				batch->elementIds.push_back(elementId);
+			}
+
+			return true;
+		}
+	}
+
+	writeGUIUpdateValue(BROADCAST_REQUEST_ID, elementId, *currentValue);
 	return true;
 }
 
+void WebGUIHandler::beginValueBatch() {
+	std::unique_lock<std::mutex> lock(packetMutex);
+	ValueBatch* batch = findValueBatch();
+
+	if (!batch) {
+		batch = &valueBatches.emplace_back();
+		batch->task = xTaskGetCurrentTaskHandle();
+		batch->depth = 0;
+	}
+
+	batch->depth++;
+}
+
+void WebGUIHandler::commitValueBatch() {
+	std::unique_lock<std::mutex> lock(packetMutex);
+	ValueBatch* batch = findValueBatch();
+
+	if (!batch || --batch->depth > 0)
+		return;
+
+	std::vector<uint16_t> elementIds = std::move(batch->elementIds);
+	valueBatches.erase(valueBatches.begin() + (batch - valueBatches.data()));
+
+	if (elementIds.empty())
+		return;
+
+	lock.unlock();
+	waitForSendQueue(AsyncBLECharacteristicWriter::Priority::Interactive, elementIds.size());
+	lock.lock();
+
+	writeGUIUpdateValues(BROADCAST_REQUEST_ID, elementIds);
+}
+
+WebGUIHandler::ValueBatch* WebGUIHandler::findValueBatch() {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+	for (ValueBatch& batch : valueBatches) {
+		if (batch.task == task)
+			return &batch;
+	}
+
+	return nullptr;
+}
+
 bool WebGUIHandler::setGUIElementFlag(const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState) {
-	webgui::IControlElement* elem = guiRoot->getElementByPath(path);
+	return setGUIElementFlag(findElementId(path), flag, newState);
+}
 
-	if (!elem)
+bool WebGUIHandler::setGUIElementFlag(uint16_t elementId, webgui::GUIFlag flag, bool newState) {
+	if (elementId >= guiModel->getElementCount())
 		return false;
 
-	bool prevState = elem->getFlag(flag);
+	bool prevState = guiModel->getElementFlagById(elementId, flag);
 
 	if (prevState == newState)
 		return true;
 
-	elem->setFlag(flag, newState);
+	guiModel->setElementFlagById(elementId, flag, newState);
 
-	writeGUIUpdateFlag(BROADCAST_REQUEST_ID, path, flag, newState);
+	writeGUIUpdateFlag(BROADCAST_REQUEST_ID, elementId, flag, newState);
 	return true;
 }
 
-void WebGUIHandler::onWrite(BLECharacteristic* pCharacteristic/*, esp_ble_gatts_cb_param_t* param*/) {
-	handleGUIRequest(*pCharacteristic);
+void WebGUIHandler::setUseElementIds(bool enabled) {
+	useElementIds = enabled;
+}
+
+void WebGUIHandler::setInterleavePackets(bool enabled) {
+	guiDataSendQueue.setStreamHeader(enabled ? std::optional<uint8_t>(uint8_t(GUIServerHeader::StreamChunk)) : std::nullopt);
+}
+
+void WebGUIHandler::setCompactTelemetry(bool enabled) {
+	compactTelemetry = enabled;
+}
+
+void WebGUIHandler::setOnClientRequestCallback(std::function<void(uint16_t conHandle)> callback) {
+	onClientRequestCallback = callback;
+}
+
+void WebGUIHandler::onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+	bleHostTask = xTaskGetCurrentTaskHandle();
+
+	if (onClientRequestCallback) {
+		onClientRequestCallback(desc->conn_handle);
+	}
+
+	handleGUIRequest(*pCharacteristic, desc->conn_handle);
 }
 
 void WebGUIHandler::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) {
 	if (pCharacteristic != guiDataSendQueue.getCharacteristic())
 		return;
 
+	bleHostTask = xTaskGetCurrentTaskHandle();
 	uint16_t conHandle = desc->conn_handle;
 
+	{
+		// Connection handles are reused, a new subscription starts with the whole GUI and without transfers
+		std::unique_lock<std::mutex> lock(subscriptionMutex);
+		hiddenSubtrees.erase(conHandle);
+
+		for (auto iter = transferSnapshots.begin(); iter != transferSnapshots.end();) {
+			if (iter->first.first == conHandle) {
+				iter->second.cancelled->store(true);
+				iter = transferSnapshots.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+	}
+
 	if (subValue == 0) {
 		guiDataSendQueue.removeSubscriber(conHandle);
 	} else {
-		guiDataSendQueue.addSubscriber(conHandle);
+		{
+			// The new client has no delta base, the next compact values are absolute
+			std::unique_lock<std::mutex> lock(packetMutex);
+			compactValueBases.clear();
+
+			guiDataSendQueue.addSubscriber(conHandle);
+		}
+
+		if (hasPublishIntervals()) {
+			startTelemetryThread();
+		}
 	}
 }
 
@@ -67,18 +267,143 @@ void WebGUIHandler::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_c
 // Private methods //
 /////////////////////
 
+void WebGUIHandler::startTelemetryThread() {
+	if (telemetryThreadStarted)
+		return;
+
+	std::unique_lock<std::mutex> lock(telemetryMutex);
+	startTelemetryThreadLocked();
+}
+
+void WebGUIHandler::startTelemetryThreadLocked() {
+	if (telemetryThread.joinable() || telemetryThreadShouldExit)
+		return;
+
+	telemetryThread = std::thread(&WebGUIHandler::TelemetryThreadFunc, this);
+	telemetryThreadStarted = true;
+}
+
+bool WebGUIHandler::hasPublishIntervals() const {
+	for (uint16_t elementId = 0; elementId < guiModel->getElementCount(); ++elementId) {
+		if (guiModel->getElementPublishIntervalById(elementId) > 0)
+			return true;
+	}
+
+	return false;
+}
+
+void WebGUIHandler::TelemetryThreadFunc() {
+	std::unique_lock<std::mutex> lock(telemetryMutex);
+
+	while (!telemetryThreadShouldExit) {
+		if (pendingBenchmarkStream) {
+			BenchmarkStream stream = *pendingBenchmarkStream;
+			pendingBenchmarkStream.reset();
+
+			lock.unlock();
+			writeBenchmarkUpdates(stream);
+			lock.lock();
+			continue;
+		}
+
+		uint32_t waitTime = sampleTelemetry();
+
+		if (!telemetryElementIds.empty()) {
+			// Sending may wait for the send queue, the BLE task and the destructor lock the telemetryMutex meanwhile
+			lock.unlock();
+			publishTelemetry();
+			lock.lock();
+		}
+
+		telemetryConditionVariable.wait_for(lock, std::chrono::milliseconds(waitTime), [&] {
+			return telemetryThreadShouldExit || pendingBenchmarkStream;
+		});
+	}
+}
+
+uint32_t WebGUIHandler::sampleTelemetry() {
+	uint16_t elementCount = guiModel->getElementCount();
+
+	telemetryElementIds.clear();
+
+	if (telemetryStates.size() < elementCount) {
+		telemetryStates.resize(elementCount);
+	}
+
+	if (getCharacteristic().getSubscribedCount() == 0) {
+		// Clients load all values with the GUI, start over when the next one subscribes
+		for (TelemetryState& state : telemetryStates) {
+			state = {};
+		}
+
+		return TELEMETRY_RESCAN_INTERVAL_MS;
+	}
+
+	unsigned long now = millis();
+	uint32_t nextDue = TELEMETRY_RESCAN_INTERVAL_MS;
+
+	for (uint16_t elementId = 0; elementId < elementCount; ++elementId) {
+		uint32_t interval = guiModel->getElementPublishIntervalById(elementId);
+
+		if (interval == 0)
+			continue;
+
+		TelemetryState& state = telemetryStates[elementId];
+
+		if (state.lastSample) {
+			unsigned long elapsed = now - *state.lastSample;
+
+			if (elapsed < interval) {
+				nextDue = std::min(nextDue, uint32_t(interval - elapsed));
+				continue;
+			}
+		}
+
+		state.lastSample = now;
+		nextDue = std::min(nextDue, interval);
+
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value || value == state.lastValue)
+			continue;
+
+		state.lastValue = std::move(value);
+		telemetryElementIds.push_back(elementId);
+	}
+
+	return nextDue;
+}
+
+void WebGUIHandler::publishTelemetry() {
+	waitForSendQueue(AsyncBLECharacteristicWriter::Priority::Telemetry, telemetryElementIds.size());
+
+	std::unique_lock<std::mutex> lock(packetMutex);
+
+	if (compactTelemetry) {
+		writeGUIUpdateValuesCompact(telemetryElementIds);
+	} else {
+		writeGUIUpdateValues(BROADCAST_REQUEST_ID, telemetryElementIds, AsyncBLECharacteristicWriter::Priority::Telemetry);
+	}
+}
+
 NimBLECharacteristic& WebGUIHandler::getCharacteristic() {
 	return *guiDataSendQueue.getCharacteristic();
 }
 
-void WebGUIHandler::handleGUIRequest(BLECharacteristic& characteristic) {
-	if (characteristic.getDataLength() == 0)
+void WebGUIHandler::handleGUIRequest(BLECharacteristic& characteristic, uint16_t conHandle) {
+	if (characteristic.getDataLength() < 5)
 		return;
 
+	// The requests are parsed directly from the attribute value, without copying the content
 	NimBLEAttValue value = characteristic.getValue();
 
+	if (value.size() < 5)
+		return;
+
 	uint8_t headByte = value[0];
-	uint32_t requestId = ntohl(PeekUInt32(value.begin() + 1));
+	uint32_t requestId = ntohl(PeekUInt32(value.data() + 1));
+	const uint8_t* content = value.data() + 5;
+	size_t contentLength = value.size() - 5;
 
 	if (headByte >= uint8_t(GUIClientHeader::COUNT))
 		return;
@@ -89,9 +414,53 @@ void WebGUIHandler::handleGUIRequest(BLECharacteristic& characteristic) {
 			break;
 		}
 
+		case GUIClientHeader::RequestGUIBinary: {
+			writeGUIInfoDataBinary(requestId);
+			break;
+		}
+
+		case GUIClientHeader::RequestGUIHash: {
+			writeGUIHash(requestId);
+			break;
+		}
+
+		case GUIClientHeader::RequestGUIValues: {
+			writeGUIValues(requestId);
+			break;
+		}
+
 		case GUIClientHeader::SetValue: {
-			std::vector<uint8_t> remainingData(value.begin() + 5, value.end());
-			handleGUISetValueRequest(requestId, remainingData);
+			handleGUISetValueRequest(requestId, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::SetValueById: {
+			handleGUISetValueByIdRequest(requestId, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::SetValues: {
+			handleGUISetValuesRequest(requestId, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::RequestTransfer: {
+			handleGUITransferRequest(conHandle, requestId, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::SetSubtreeVisible: {
+			handleGUISetSubtreeVisibleRequest(conHandle, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::RequestGUISubtree: {
+			writeGUISubtree(requestId, content, contentLength);
+			break;
+		}
+
+		case GUIClientHeader::Benchmark: {
+			handleGUIBenchmarkRequest(requestId, content, contentLength);
 			break;
 		}
 
@@ -101,243 +470,771 @@ void WebGUIHandler::handleGUIRequest(BLECharacteristic& characteristic) {
 	}
 }
 
-void WebGUIHandler::handleGUISetValueRequest(uint32_t requestId, const std::vector<uint8_t>& content) {
-	if (content.size() < 4) {
+void WebGUIHandler::handleGUISetValueRequest(uint32_t requestId, const uint8_t* content, size_t length) {
+	if (length < 4) {
 		return;
 	}
 
-	uint32_t keyLength = ntohl(PeekUInt32(content.data() + 0));
+	uint32_t keyLength = ntohl(PeekUInt32(content + 0));
 
-	if (content.size() < 4 + keyLength) {
+	if (length - 4 < keyLength) {
 		return;
 	}
 
-	std::string name = {reinterpret_cast<const char*>(content.data() + 4), reinterpret_cast<const char*>(content.data() + 4 + keyLength)};
-	std::vector<std::string> path = SplitString(name, ",");
+	std::string_view name(reinterpret_cast<const char*>(content + 4), keyLength);
 
-	size_t offset = 4 + keyLength;
+	uint16_t elementId = guiModel->findElementId(name);
 
-	if (content.size() < offset + 1) {
+	if (elementId == webgui::INVALID_ELEMENT_ID) {
+		Serial.printf("Unable to map GUI element with path '%.*s', ignoring\n", int(name.size()), name.data());
 		return;
 	}
 
-	using ValueType = webgui::ValueType;
+	handleGUISetElementValue(requestId, elementId, content + 4 + keyLength, length - 4 - keyLength);
+}
 
-	ValueType type = static_cast<ValueType>(content[offset]);
+void WebGUIHandler::handleGUISetValueByIdRequest(uint32_t requestId, const uint8_t* content, size_t length) {
+	if (length < 2) {
+		return;
+	}
 
-	webgui::IControlElement* elem = guiRoot->getElementByPath(path);
+	uint16_t elementId = ntohs(PeekUInt16(content + 0));
 
-	if (!elem) {
-		Serial.printf("Unable to map GUI element with path '%s', ignoring\n", name.c_str());
+	if (elementId >= guiModel->getElementCount()) {
+		Serial.printf("Unable to map GUI element with id %u, ignoring\n", elementId);
 		return;
 	}
 
-	if (elem->getFlag(webgui::GUIFlag::ReadOnly)) {
-		Serial.printf("Ignore update for element '%s' as its set to read only!\n", name.c_str());
+	handleGUISetElementValue(requestId, elementId, content + 2, length - 2);
+}
+
+void WebGUIHandler::handleGUISetElementValue(uint32_t requestId, uint16_t elementId, const uint8_t* content, size_t length) {
+	if (isReadOnlyElement(elementId))
 		return;
-	}
 
-	switch (type) {
-		case ValueType::Int32: {
-			if (content.size() < offset + 5) {
-				return;
-			}
+	size_t valueLength;
+	std::optional<webgui::Value> value = DecodeValue(content, length, valueLength);
 
-			uint32_t value = ntohl(PeekUInt32(content.data() + offset + 1));
-			guiRoot->setValue(path, webgui::Int32ValueWrapper(value));
-			writeGUIUpdateValue(requestId, name, webgui::Int32ValueWrapper(value));
-			break;
-		}
+	if (!value)
+		return;
 
-		case ValueType::Boolean: {
-			if (content.size() < offset + 2) {
-				return;
-			}
+	guiModel->setElementValueById(elementId, *value);
+	// TODO: Dont broadcast password fields
+	writeGUIUpdateValue(requestId, elementId, *value);
+}
 
-			bool value = PeekUInt8(content.data() + offset + 1);
-			guiRoot->setValue(path, webgui::BooleanValueWrapper(value));
-			writeGUIUpdateValue(requestId, name, webgui::BooleanValueWrapper(value));
-			break;
+void WebGUIHandler::handleGUISetValuesRequest(uint32_t requestId, const uint8_t* content, size_t length) {
+	// Decode the whole transaction first, the values are only applied when all of them are valid
+	std::vector<std::pair<uint16_t, webgui::Value>> values;
+	size_t offset = 0;
+
+	while (offset < length) {
+		if (length - offset < 2) {
+			return;
 		}
 
-		case ValueType::String: {
-			if (content.size() < offset + 5) {
-				return;
-			}
+		uint16_t elementId = ntohs(PeekUInt16(content + offset));
+		offset += 2;
 
-			uint32_t strLength = ntohl(PeekUInt32(content.data() + offset + 1));
-			offset += 5;
+		if (elementId >= guiModel->getElementCount()) {
+			Serial.printf("Unable to map GUI element with id %u, ignoring transaction\n", elementId);
+			return;
+		}
 
-			if (content.size() < offset + strLength) {
-				Serial.printf("Ignore string value, as the content is too small, data length: %u bytes, string length: %" PRIu32 " bytes\n", content.size(), strLength);
-				return;
-			}
+		if (isReadOnlyElement(elementId))
+			return;
 
-			std::string value = {reinterpret_cast<const char*>(content.data() + offset), reinterpret_cast<const char*>(content.data() + offset + strLength)};
-			guiRoot->setValue(path, webgui::StringValueWrapper(value));
-			// TODO: Dont broadcast password fields
-			writeGUIUpdateValue(requestId, name, webgui::StringValueWrapper(value));
-			break;
-		}
+		size_t valueLength;
+		std::optional<webgui::Value> value = DecodeValue(content + offset, length - offset, valueLength);
 
-		case ValueType::RGBWColor: {
-			if (content.size() < offset + 5) {
-				return;
-			}
+		if (!value)
+			return;
 
-			uint8_t wrgbBytes[4];
-			memcpy(wrgbBytes, content.data() + offset + 1, 4);
-			RGBW color(wrgbBytes[1], wrgbBytes[2], wrgbBytes[3], wrgbBytes[0]);
+		values.emplace_back(elementId, std::move(*value));
+		offset += valueLength;
+	}
 
-			guiRoot->setValue(path, webgui::RGBWValueWrapper(color));
-			writeGUIUpdateValue(requestId, name, webgui::RGBWValueWrapper(color));
-			break;
-		}
+	std::vector<uint16_t> elementIds;
+	elementIds.reserve(values.size());
 
-		case ValueType::Float32: {
-			if (content.size() < offset + 5) {
-				return;
-			}
+	// Value changes notified by the application callbacks while applying are send together after the echo
+	beginValueBatch();
 
-			float value = ntohl(PeekFloat32(content.data() + offset + 1));
-			guiRoot->setValue(path, webgui::Float32ValueWrapper(value));
-			writeGUIUpdateValue(requestId, name, webgui::Float32ValueWrapper(value));
-			break;
-		}
+	for (const auto& [elementId, value] : values) {
+		guiModel->setElementValueById(elementId, value);
 
-		default:
-			Serial.printf("Unhandled value data type: %" PRIu32 "\n", uint32_t(type));
-			return;
+		if (std::find(elementIds.begin(), elementIds.end(), elementId) == elementIds.end()) {
+			elementIds.push_back(elementId);
+		}
 	}
-}
 
-void WebGUIHandler::writeGUIInfoDataV1(uint32_t requestId) {
-	std::string json = guiRoot->toJSON();
+	guiModel->notifyValuesCommitted();
 
-	writeCharacteristicData(GUIServerHeader::GUIData, requestId, reinterpret_cast<const uint8_t*>(json.data()), json.size());
+	{
+		std::unique_lock<std::mutex> lock(packetMutex);
+		writeGUIUpdateValues(requestId, elementIds);
+	}
+
+	commitValueBatch();
 }
 
-void WebGUIHandler::writeGUIUpdateValue(uint32_t requestId, const std::vector<std::string>& path, const webgui::AValueWrapper& value) {
-	writeGUIUpdateValue(requestId, ConcatPath(path), value);
+bool WebGUIHandler::isReadOnlyElement(uint16_t elementId) const {
+	if (!guiModel->getElementFlagById(elementId, webgui::GUIFlag::ReadOnly))
+		return false;
+
+	std::string_view name = guiModel->getElementPath(elementId);
+	Serial.printf("Ignore update for element '%.*s' as its set to read only!\n", int(name.size()), name.data());
+	return true;
 }
 
-void WebGUIHandler::writeGUIUpdateValue(uint32_t requestId, const std::string& name, const webgui::AValueWrapper& value) {
-	std::vector<uint8_t> namePart = StringToLengthPrefixedVector(name);
-	std::vector<uint8_t> valuePart(1);
+void WebGUIHandler::handleGUITransferRequest(uint16_t conHandle, uint32_t requestId, const uint8_t* content, size_t length) {
+	if (length < 5) {
+		return;
+	}
 
-	valuePart[0] = uint8_t(value.getType());
+	uint8_t requestType = content[0];
+	uint32_t offset = ntohl(PeekUInt32(content + 1));
 
-	using ValueType = webgui::ValueType;
+	if (requestType != uint8_t(GUIClientHeader::RequestGUIBinary) && requestType != uint8_t(GUIClientHeader::RequestGUIValues)) {
+		Serial.printf("Unsupported transfer request type: %u\n", requestType);
+		return;
+	}
 
-	switch (value.getType()) {
-		case ValueType::Int32: {
-			valuePart.resize(5);
-			PokeUInt32(valuePart.data() + 1, htonl(value.getAsInt32()));
-			break;
-		}
+	if (!hasSubscribers())
+		return;
 
-		case ValueType::Boolean: {
-			valuePart.resize(2);
-			valuePart[1] = value.getAsBool();
-			break;
-		}
+	std::pair<uint16_t, uint8_t> transferKey(conHandle, requestType);
+	std::shared_ptr<const std::vector<uint8_t>> data;
+	uint32_t crc = 0;
 
-		case ValueType::String: {
-			valuePart = MergeVectors(valuePart, StringToLengthPrefixedVector(value.getAsString()));
-			break;
-		}
+	{
+		std::unique_lock<std::mutex> lock(subscriptionMutex);
+		auto iter = transferSnapshots.find(transferKey);
 
-		case ValueType::RGBWColor: {
-			// Note: Here should dynamic_cast be used. But we compile with -fno-rtti
-			const webgui::RGBWValueWrapper& rgbwValue = static_cast<const webgui::RGBWValueWrapper&>(value);
-
-			valuePart.resize(5);
-			valuePart[1] = rgbwValue.value.w;
-			valuePart[2] = rgbwValue.value.r;
-			valuePart[3] = rgbwValue.value.g;
-			valuePart[4] = rgbwValue.value.b;
-			break;
-		}
+		if (iter != transferSnapshots.end()) {
+			// The segments still queued for the previous request are ignored by the client
+			iter->second.cancelled->store(true);
 
-		case ValueType::Float32: {
-			valuePart.resize(5);
-			PokeFloat32(valuePart.data() + 1, htonf(value.getAsFloat32()));
-			break;
+			if (offset > 0 && offset <= iter->second.data->size()) {
+				data = iter->second.data;
+				crc = iter->second.crc;
+			}
 		}
 	}
 
-	writeCharacteristicData(GUIServerHeader::UpdateValue, requestId, MergeVectors(namePart, valuePart));
-}
+	if (!data) {
+		// The schema contains the current values, a resume must not see the values changed since the first request
+		std::vector<uint8_t> snapshot;
 
-void WebGUIHandler::writeGUIUpdateFlag(uint32_t requestId, const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState) {
-	writeGUIUpdateFlag(requestId, ConcatPath(path), flag, newState);
-}
+		if (requestType == uint8_t(GUIClientHeader::RequestGUIBinary)) {
+			webgui::BinarySchemaWriter writer;
+			guiModel->appendBinarySchema(writer);
+			snapshot = std::move(writer.data);
+		} else {
+			snapshot = createGUIValuesContent();
+		}
 
-void WebGUIHandler::writeGUIUpdateFlag(uint32_t requestId, const std::string& name, webgui::GUIFlag flag, bool newState) {
-	std::vector<uint8_t> namePart = StringToLengthPrefixedVector(name);
-	std::vector<uint8_t> valuePart(2);
+		crc = ComputeCRC32(snapshot.data(), snapshot.size());
+		data = std::make_shared<const std::vector<uint8_t>>(std::move(snapshot));
+	}
 
-	valuePart[0] = static_cast<uint8_t>(flag);
-	valuePart[1] = newState;
+	std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
 
-	writeCharacteristicData(GUIServerHeader::UpdateFlag, requestId, MergeVectors(namePart, valuePart));
-}
+	{
+		std::unique_lock<std::mutex> lock(subscriptionMutex);
+		transferSnapshots[transferKey] = {data, crc, cancelled};
+	}
 
-void WebGUIHandler::writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const std::vector<uint8_t>& data) {
-	writeCharacteristicData(headByte, requestId, data.data(), data.size());
+	guiDataSendQueue.append(std::make_unique<TransferChunkSource>(requestId, data, crc, offset, cancelled), AsyncBLECharacteristicWriter::Priority::Bulk,
+		conHandle);
 }
 
-void WebGUIHandler::writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const uint8_t* data, size_t length) {
-	if (getCharacteristic().getSubscribedCount() == 0) {
-		Serial.printf("No characteristic subscribers, ignoring\n");
+void WebGUIHandler::handleGUIBenchmarkRequest(uint32_t requestId, const uint8_t* content, size_t length) {
+	if (length < 1) {
 		return;
 	}
 
-	std::optional<uint16_t> clientMtu = BLELedController::GetInstance()->getClientsContentMtu();
-
-	if (!clientMtu) {
-		// No clients connected? Ignore write request.
+	if (!hasSubscribers())
 		return;
-	}
 
-	if (*clientMtu < 10) {
-		Print* errorLogTarget = BLELedController::GetInstance()->getErrorLogTarget();
+	uint8_t benchmarkType = content[0];
 
-		if (errorLogTarget) {
-			errorLogTarget->printf("Cannot send data, need at least 10 bytes MTU but reported client MTU is %u\n", *clientMtu);
+	if (benchmarkType == uint8_t(GUIBenchmarkType::Ping)) {
+		// Echoed unchanged, the client measures the round trip time with its own clock
+		writeCharacteristicData(GUIServerHeader::BenchmarkData, requestId, content, length);
+	} else if (benchmarkType == uint8_t(GUIBenchmarkType::StreamBytes)) {
+		if (length < 5) {
+			return;
 		}
 
-		return;
-	}
-
-	std::vector<uint8_t> sendBuffer(*clientMtu);
-
-	sendBuffer[0] = static_cast<uint8_t>(headByte);
-	PokeUInt32(sendBuffer.data() + 1, htonl(requestId));
-	PokeUInt32(sendBuffer.data() + 5, htonl(length));
+		uint32_t streamLength = std::min(ntohl(PeekUInt32(content + 1)), BENCHMARK_MAX_STREAM_LENGTH);
 
-	size_t offset = std::min(sendBuffer.size() - 9, length);
-	memcpy(sendBuffer.data() + 9, data, offset);
-
-	// Write first chunk
-	size_t firstChunkSize = 9 + offset;
+		guiDataSendQueue.append(std::make_unique<BenchmarkChunkSource>(requestId, streamLength), AsyncBLECharacteristicWriter::Priority::Bulk);
+	} else if (benchmarkType == uint8_t(GUIBenchmarkType::StreamUpdates)) {
+		if (length < 9) {
+			return;
+		}
 
-	guiDataSendQueue.append(sendBuffer.data(), firstChunkSize);
+		// Each update fits into one notification of the largest MTU
+		constexpr size_t maxContentSize = AsyncBLECharacteristicWriter::MAX_CHUNK_SIZE - PACKET_HEADER_SIZE;
 
-	// Send remaining data
-	while (length > offset) {
-		size_t blockSize = std::min(length - offset, sendBuffer.size());
+		BenchmarkStream stream;
+		stream.requestId = requestId;
+		stream.count = std::min(ntohl(PeekUInt32(content + 1)), BENCHMARK_MAX_UPDATE_COUNT);
+		stream.contentSize = uint16_t(std::clamp(size_t(ntohs(PeekUInt16(content + 5))), BENCHMARK_UPDATE_HEADER_SIZE, maxContentSize));
+		stream.intervalMs = ntohs(PeekUInt16(content + 7));
 
-		guiDataSendQueue.append(data + offset, blockSize);
-		offset += blockSize;
+		// The BLE task must not block, the telemetry thread waits for the send queue
+		std::unique_lock<std::mutex> lock(telemetryMutex);
+		startTelemetryThreadLocked();
+		pendingBenchmarkStream = stream;
+		telemetryConditionVariable.notify_all();
+	} else {
+		Serial.printf("Unsupported benchmark type: %u\n", benchmarkType);
 	}
 }
 
-std::string WebGUIHandler::ConcatPath(const std::vector<std::string>& path) {
-	std::string result;
+void WebGUIHandler::writeBenchmarkUpdates(const BenchmarkStream& stream) {
+	for (uint32_t sequence = 0; sequence < stream.count; ++sequence) {
+		{
+			std::unique_lock<std::mutex> lock(telemetryMutex);
 
-	for (size_t i = 0; i < path.size(); ++i) {
-		result += path[i];
+			bool stopped = telemetryConditionVariable.wait_for(lock, std::chrono::milliseconds(sequence > 0 ? stream.intervalMs : 0), [&] {
+				return telemetryThreadShouldExit || pendingBenchmarkStream;
+			});
+
+			if (stopped)
+				return;
+		}
+
+		if (getCharacteristic().getSubscribedCount() == 0)
+			return;
+
+		// Same path as the periodic values, waits while the queue is full
+		waitForSendQueue(AsyncBLECharacteristicWriter::Priority::Telemetry);
+
+		std::unique_lock<std::mutex> lock(packetMutex);
+
+		packetBuffer.assign(PACKET_HEADER_SIZE + BENCHMARK_UPDATE_HEADER_SIZE, 0);
+
+		uint8_t* content = packetBuffer.data() + PACKET_HEADER_SIZE;
+		content[0] = uint8_t(GUIBenchmarkType::StreamUpdates);
+		PokeUInt32(content + 1, htonl(sequence));
+		PokeUInt32(content + 5, htonl(stream.count));
+		PokeUInt32(content + 9, htonl(uint32_t(millis())));
+
+		packetBuffer.resize(PACKET_HEADER_SIZE + stream.contentSize, 0);
+
+		writePacketBuffer(GUIServerHeader::BenchmarkData, stream.requestId, AsyncBLECharacteristicWriter::NO_COALESCE_KEY,
+			AsyncBLECharacteristicWriter::Priority::Telemetry);
+	}
+}
+
+void WebGUIHandler::handleGUISetSubtreeVisibleRequest(uint16_t conHandle, const uint8_t* content, size_t length) {
+	if (length < 5) {
+		return;
+	}
+
+	bool visible = content[0] != 0;
+	uint32_t pathLength = ntohl(PeekUInt32(content + 1));
+
+	if (length - 5 < pathLength) {
+		return;
+	}
+
+	std::string path(reinterpret_cast<const char*>(content + 5), pathLength);
+
+	{
+		std::unique_lock<std::mutex> lock(subscriptionMutex);
+		std::vector<std::string>& subtrees = hiddenSubtrees[conHandle];
+		auto iter = std::find(subtrees.begin(), subtrees.end(), path);
+
+		if (!visible) {
+			if (iter == subtrees.end()) {
+				subtrees.push_back(std::move(path));
+			}
+
+			return;
+		}
+
+		if (iter == subtrees.end())
+			return;
+
+		subtrees.erase(iter);
+
+		if (subtrees.empty()) {
+			hiddenSubtrees.erase(conHandle);
+		}
+	}
+
+	// Send the values which changed while the subtree was hidden to the client, the values of other hidden subtrees are filtered.
+	// The compact values of the subtree were absolute while it was hidden, the delta bases stay valid.
+	std::vector<uint16_t> elementIds;
+
+	for (uint16_t elementId = 0; elementId < guiModel->getElementCount(); ++elementId) {
+		if (IsInSubtree(guiModel->getElementPath(elementId), path)) {
+			elementIds.push_back(elementId);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(packetMutex);
+	writeGUIUpdateValues(BROADCAST_REQUEST_ID, elementIds, AsyncBLECharacteristicWriter::Priority::Interactive, conHandle);
+}
+
+bool WebGUIHandler::isElementVisible(uint16_t conHandle, uint16_t elementId) {
+	std::unique_lock<std::mutex> lock(subscriptionMutex);
+	auto iter = hiddenSubtrees.find(conHandle);
+
+	if (iter == hiddenSubtrees.end())
+		return true;
+
+	return !IsInSubtrees(guiModel->getElementPath(elementId), iter->second);
+}
+
+uint32_t WebGUIHandler::getHiddenMask(uint16_t elementId) {
+	std::unique_lock<std::mutex> lock(subscriptionMutex);
+
+	if (hiddenSubtrees.empty())
+		return 0;
+
+	std::string_view path = guiModel->getElementPath(elementId);
+	uint32_t mask = 0;
+	uint32_t bit = 1;
+
+	for (const auto& [conHandle, subtrees] : hiddenSubtrees) {
+		if (IsInSubtrees(path, subtrees)) {
+			mask |= bit;
+		}
+
+		bit <<= 1;
+	}
+
+	return mask;
+}
+
+void WebGUIHandler::writeGUIInfoDataV1(uint32_t requestId) {
+	if (!hasSubscribers())
+		return;
+
+	// Stream the JSON from the cached template, the writer thread reads it chunk by chunk
+	std::unique_ptr<JSONChunkSource> source = std::make_unique<JSONChunkSource>(guiModel->getJSONTemplate());
+	source->setHeader(CreatePacketHeader(GUIServerHeader::GUIData, requestId, source->getContentLength()));
+
+	guiDataSendQueue.append(std::move(source), AsyncBLECharacteristicWriter::Priority::Bulk);
+}
+
+void WebGUIHandler::writeGUISubtree(uint32_t requestId, const uint8_t* content, size_t length) {
+	if (length < 5) {
+		return;
+	}
+
+	uint8_t depth = content[0];
+	uint32_t pathLength = ntohl(PeekUInt32(content + 1));
+
+	if (length - 5 < pathLength) {
+		return;
+	}
+
+	if (!hasSubscribers())
+		return;
+
+	std::string_view path(reinterpret_cast<const char*>(content + 5), pathLength);
+	uint16_t elementId = path.empty() ? webgui::INVALID_ELEMENT_ID : guiModel->findElementId(path);
+
+	std::vector<uint8_t> hash(4);
+	PokeUInt32(hash.data(), htonl(guiModel->getStructureHash()));
+
+	std::shared_ptr<const webgui::JSONTemplate> jsonTemplate;
+
+	if (!path.empty() && elementId == webgui::INVALID_ELEMENT_ID) {
+		Serial.printf("GUI subtree '%.*s' not found\n", int(path.size()), path.data());
+	} else {
+		jsonTemplate = guiModel->getSubtreeJSONTemplate(elementId, depth);
+	}
+
+	if (!jsonTemplate) {
+		// The GUI was changed, the client reloads it
+		writeCharacteristicData(GUIServerHeader::GUISubtree, requestId, hash);
+		return;
+	}
+
+	std::unique_ptr<JSONChunkSource> source = std::make_unique<JSONChunkSource>(jsonTemplate);
+	std::vector<uint8_t> header = CreatePacketHeader(GUIServerHeader::GUISubtree, requestId, hash.size() + source->getContentLength());
+	header.insert(header.end(), hash.begin(), hash.end());
+	source->setHeader(std::move(header));
+
+	guiDataSendQueue.append(std::move(source), AsyncBLECharacteristicWriter::Priority::Bulk);
+}
+
+void WebGUIHandler::writeGUIInfoDataBinary(uint32_t requestId) {
+	if (!hasSubscribers())
+		return;
+
+	// The schema is written behind the space of the packet header, the whole packet is handed over to the send queue
+	webgui::BinarySchemaWriter writer;
+	writer.data.resize(PACKET_HEADER_SIZE);
+	guiModel->appendBinarySchema(writer);
+
+	WritePacketHeader(writer.data.data(), GUIServerHeader::GUIDataBinary, requestId, writer.data.size() - PACKET_HEADER_SIZE);
+	guiDataSendQueue.appendPacket(std::move(writer.data), AsyncBLECharacteristicWriter::Priority::Bulk);
+}
+
+void WebGUIHandler::writeGUIHash(uint32_t requestId) {
+	std::vector<uint8_t> content(4);
+	PokeUInt32(content.data(), htonl(guiModel->getStructureHash()));
+
+	// Older clients only read the hash
+	content.push_back(GUI_CAPABILITY_RELIABLE_TRANSFER | GUI_CAPABILITY_SUBTREES | GUI_CAPABILITY_BENCHMARK);
+
+	writeCharacteristicData(GUIServerHeader::GUIHash, requestId, content);
+}
+
+void WebGUIHandler::writeGUIValues(uint32_t requestId) {
+	writeCharacteristicData(GUIServerHeader::GUIValues, requestId, createGUIValuesContent(), AsyncBLECharacteristicWriter::Priority::Bulk);
+}
+
+std::vector<uint8_t> WebGUIHandler::createGUIValuesContent() {
+	std::vector<uint8_t> content(4);
+	PokeUInt32(content.data(), htonl(guiModel->getStructureHash()));
+
+	for (uint16_t elementId = 0; elementId < guiModel->getElementCount(); ++elementId) {
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value)
+			continue;
+
+		size_t offset = content.size();
+		content.resize(offset + 2);
+		PokeUInt16(content.data() + offset, htons(elementId));
+
+		AppendEncodedValue(content, *value);
+	}
+
+	return content;
+}
+
+void WebGUIHandler::writeGUIUpdateValue(uint32_t requestId, uint16_t elementId, const webgui::Value& value) {
+	GUIServerHeader header = useElementIds ? GUIServerHeader::UpdateValueById : GUIServerHeader::UpdateValue;
+
+	waitForSendQueue(AsyncBLECharacteristicWriter::Priority::Interactive);
+
+	std::unique_lock<std::mutex> lock(packetMutex);
+
+	packetBuffer.resize(PACKET_HEADER_SIZE);
+	appendElementReference(packetBuffer, elementId);
+	AppendEncodedValue(packetBuffer, value);
+
+	// Only the latest value of an element is of interest
+	writePacketBuffer(header, requestId, elementId, AsyncBLECharacteristicWriter::Priority::Interactive, elementId);
+}
+
+void WebGUIHandler::writeGUIUpdateValues(uint32_t requestId, const std::vector<uint16_t>& elementIds, AsyncBLECharacteristicWriter::Priority priority,
+	uint16_t conHandle) {
+	std::optional<uint16_t> chunkSize = getSendChunkSize();
+
+	if (!chunkSize)
+		return;
+
+	GUIServerHeader header = useElementIds ? GUIServerHeader::UpdateValuesById : GUIServerHeader::UpdateValues;
+	packetBuffer.resize(PACKET_HEADER_SIZE);
+
+	// The packet is filtered by its first element, all elements in it are hidden by the same clients
+	uint32_t packetHiddenMask = 0;
+	uint32_t packetFilterKey = AsyncBLECharacteristicWriter::NO_FILTER_KEY;
+
+	for (uint16_t elementId : elementIds) {
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value)
+			continue;
+
+		size_t recordSize = getElementReferenceSize(elementId) + GetEncodedValueSize(*value);
+
+		if (PACKET_HEADER_SIZE + recordSize > *chunkSize)
+			continue;
+
+		uint32_t hiddenMask = getHiddenMask(elementId);
+
+		if (packetBuffer.size() > PACKET_HEADER_SIZE && (packetBuffer.size() + recordSize > *chunkSize || hiddenMask != packetHiddenMask)) {
+			// A batch may contain several elements, later updates must not overtake it
+			writePacketBuffer(header, requestId, AsyncBLECharacteristicWriter::COALESCE_BARRIER, priority, packetFilterKey, conHandle);
+			packetBuffer.resize(PACKET_HEADER_SIZE);
+		}
+
+		if (packetBuffer.size() == PACKET_HEADER_SIZE) {
+			packetHiddenMask = hiddenMask;
+			packetFilterKey = hiddenMask ? elementId : AsyncBLECharacteristicWriter::NO_FILTER_KEY;
+		}
+
+		appendElementReference(packetBuffer, elementId);
+		AppendEncodedValue(packetBuffer, *value);
+	}
+
+	if (packetBuffer.size() > PACKET_HEADER_SIZE) {
+		writePacketBuffer(header, requestId, AsyncBLECharacteristicWriter::COALESCE_BARRIER, priority, packetFilterKey, conHandle);
+	}
+
+	// Values too large for a batch packet (long strings) are split over several chunks
+	GUIServerHeader singleHeader = useElementIds ? GUIServerHeader::UpdateValueById : GUIServerHeader::UpdateValue;
+
+	for (uint16_t elementId : elementIds) {
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value || PACKET_HEADER_SIZE + getElementReferenceSize(elementId) + GetEncodedValueSize(*value) <= *chunkSize)
+			continue;
+
+		packetBuffer.resize(PACKET_HEADER_SIZE);
+		appendElementReference(packetBuffer, elementId);
+		AppendEncodedValue(packetBuffer, *value);
+
+		writePacketBuffer(singleHeader, requestId, elementId, priority, elementId, conHandle);
+	}
+}
+
+void WebGUIHandler::writeGUIUpdateValuesCompact(const std::vector<uint16_t>& elementIds) {
+	std::optional<uint16_t> chunkSize = getSendChunkSize();
+
+	if (!chunkSize)
+		return;
+
+	constexpr AsyncBLECharacteristicWriter::Priority priority = AsyncBLECharacteristicWriter::Priority::Telemetry;
+
+	if (compactValueBases.size() < guiModel->getElementCount()) {
+		compactValueBases.resize(guiModel->getElementCount());
+	}
+
+	// Filtered by the first element, same as in writeGUIUpdateValues()
+	uint32_t packetHiddenMask = 0;
+	uint32_t packetFilterKey = AsyncBLECharacteristicWriter::NO_FILTER_KEY;
+
+	// The packets are complete with the head byte, the records continue until the end of the notification.
+	// The bases only advance when the packet was queued, after a dropped packet the deltas refer to the previous values.
+	auto writeCompactPacket = [&] {
+		bool queued = guiDataSendQueue.appendPacket(packetBuffer.data(), 1, packetBuffer.data() + 1, packetBuffer.size() - 1,
+			AsyncBLECharacteristicWriter::COALESCE_BARRIER, false, priority, packetFilterKey);
+
+		if (queued) {
+			for (const auto& [elementId, base] : compactPacketBases) {
+				compactValueBases[elementId] = base;
+			}
+		}
+
+		compactPacketBases.clear();
+		packetBuffer.resize(1);
+	};
+
+	packetBuffer.assign(1, uint8_t(GUIServerHeader::UpdateValuesCompact));
+
+	for (uint16_t elementId : elementIds) {
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value)
+			continue;
+
+		// Filtered packets are missed by some clients, elements hidden by any client are send as absolute values only
+		uint32_t hiddenMask = getHiddenMask(elementId);
+		std::optional<int32_t> delta = hiddenMask ? std::nullopt : getCompactDelta(elementId, *value);
+		size_t recordSize = GetCompactValueSize(elementId, *value, delta);
+
+		if (1 + recordSize > *chunkSize)
+			continue;
+
+		if (packetBuffer.size() > 1 && (packetBuffer.size() + recordSize > *chunkSize || hiddenMask != packetHiddenMask)) {
+			writeCompactPacket();
+		}
+
+		if (packetBuffer.size() == 1) {
+			packetHiddenMask = hiddenMask;
+			packetFilterKey = hiddenMask ? elementId : AsyncBLECharacteristicWriter::NO_FILTER_KEY;
+		}
+
+		AppendCompactValue(packetBuffer, elementId, *value, delta);
+
+		if (hiddenMask) {
+			// Clients which hide the element keep their older base, the next delta must not refer to this value
+			compactValueBases[elementId].reset();
+		} else if (value->getType() == webgui::ValueType::Int32) {
+			const std::optional<CompactValueBase>& base = compactValueBases[elementId];
+			compactPacketBases.emplace_back(elementId, CompactValueBase{value->getAsInt32(), uint8_t(delta ? base->deltaCount + 1 : 0)});
+		}
+	}
+
+	if (packetBuffer.size() > 1) {
+		writeCompactPacket();
+	}
+
+	// Values too large for a compact packet (long strings) are split over several chunks
+	GUIServerHeader singleHeader = useElementIds ? GUIServerHeader::UpdateValueById : GUIServerHeader::UpdateValue;
+
+	for (uint16_t elementId : elementIds) {
+		std::optional<webgui::Value> value = guiModel->getElementValueById(elementId);
+
+		if (!value || value->getType() != webgui::ValueType::String || 1 + GetCompactValueSize(elementId, *value, {}) <= *chunkSize)
+			continue;
+
+		packetBuffer.resize(PACKET_HEADER_SIZE);
+		appendElementReference(packetBuffer, elementId);
+		AppendEncodedValue(packetBuffer, *value);
+
+		writePacketBuffer(singleHeader, BROADCAST_REQUEST_ID, elementId, priority, elementId);
+	}
+}
+
+std::optional<int32_t> WebGUIHandler::getCompactDelta(uint16_t elementId, const webgui::Value& value) const {
+	if (value.getType() != webgui::ValueType::Int32 || elementId >= compactValueBases.size())
+		return {};
+
+	const std::optional<CompactValueBase>& base = compactValueBases[elementId];
+
+	if (!base || base->deltaCount >= COMPACT_KEYFRAME_INTERVAL)
+		return {};
+
+	// Wraps around like the int32 arithmetic of the client
+	int32_t newValue = value.getAsInt32();
+	int32_t delta = int32_t(uint32_t(newValue) - uint32_t(base->value));
+
+	// The absolute value resyncs clients which missed a packet, use it whenever it is not larger
+	if (GetVarUIntSize(ZigZagEncode(delta)) >= GetVarUIntSize(ZigZagEncode(newValue)))
+		return {};
+
+	return delta;
+}
+
+void WebGUIHandler::writeGUIUpdateFlag(uint32_t requestId, uint16_t elementId, webgui::GUIFlag flag, bool newState) {
+	GUIServerHeader header = useElementIds ? GUIServerHeader::UpdateFlagById : GUIServerHeader::UpdateFlag;
+
+	waitForSendQueue(AsyncBLECharacteristicWriter::Priority::Interactive);
+
+	std::unique_lock<std::mutex> lock(packetMutex);
+
+	packetBuffer.resize(PACKET_HEADER_SIZE);
+	appendElementReference(packetBuffer, elementId);
+	packetBuffer.push_back(static_cast<uint8_t>(flag));
+	packetBuffer.push_back(newState);
+
+	writePacketBuffer(header, requestId);
+}
+
+void WebGUIHandler::appendElementReference(std::vector<uint8_t>& target, uint16_t elementId) const {
+	if (useElementIds) {
+		size_t offset = target.size();
+		target.resize(offset + 2);
+		PokeUInt16(target.data() + offset, htons(elementId));
+		return;
+	}
+
+	AppendLengthPrefixedString(target, guiModel->getElementPath(elementId));
+}
+
+size_t WebGUIHandler::getElementReferenceSize(uint16_t elementId) const {
+	return useElementIds ? 2 : 4 + guiModel->getElementPath(elementId).size();
+}
+
+void WebGUIHandler::writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const std::vector<uint8_t>& data, AsyncBLECharacteristicWriter::Priority priority) {
+	writeCharacteristicData(headByte, requestId, data.data(), data.size(), priority);
+}
+
+void WebGUIHandler::writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const uint8_t* data, size_t length, AsyncBLECharacteristicWriter::Priority priority) {
+	if (!hasSubscribers())
+		return;
+
+	uint8_t header[PACKET_HEADER_SIZE];
+	WritePacketHeader(header, headByte, requestId, length);
+
+	guiDataSendQueue.appendPacket(header, PACKET_HEADER_SIZE, data, length, AsyncBLECharacteristicWriter::NO_COALESCE_KEY, false, priority);
+}
+
+bool WebGUIHandler::writePacketBuffer(GUIServerHeader headByte, uint32_t requestId, uint32_t coalesceKey, AsyncBLECharacteristicWriter::Priority priority,
+	uint32_t filterKey, uint16_t conHandle) {
+	if (!hasSubscribers())
+		return false;
+
+	size_t contentLength = packetBuffer.size() - PACKET_HEADER_SIZE;
+	WritePacketHeader(packetBuffer.data(), headByte, requestId, contentLength);
+
+	// Packets larger than a slot can't be replaced, but keep newer packets of the same key behind them
+	bool replaceable = (coalesceKey != AsyncBLECharacteristicWriter::NO_COALESCE_KEY) && (coalesceKey != AsyncBLECharacteristicWriter::COALESCE_BARRIER)
+		&& (requestId == BROADCAST_REQUEST_ID) && (conHandle == AsyncBLECharacteristicWriter::ALL_SUBSCRIBERS)
+		&& (packetBuffer.size() <= AsyncBLECharacteristicWriter::MAX_CHUNK_SIZE);
+
+	return guiDataSendQueue.appendPacket(packetBuffer.data(), PACKET_HEADER_SIZE, packetBuffer.data() + PACKET_HEADER_SIZE, contentLength,
+		coalesceKey, replaceable, priority, filterKey, conHandle);
+}
+
+void WebGUIHandler::waitForSendQueue(AsyncBLECharacteristicWriter::Priority priority, size_t packetCount) {
+	if (xTaskGetCurrentTaskHandle() == bleHostTask)
+		return;
+
+	guiDataSendQueue.waitForFreeSlots(priority, packetCount);
+}
+
+bool WebGUIHandler::hasSubscribers() {
+	if (getCharacteristic().getSubscribedCount() == 0) {
+		Serial.printf("No characteristic subscribers, ignoring\n");
+		return false;
+	}
+
+	return true;
+}
+
+std::optional<uint16_t> WebGUIHandler::getSendChunkSize() {
+	if (!hasSubscribers())
+		return {};
+
+	std::optional<uint16_t> clientMtu = BLELedController::GetInstance()->getClientsContentMtu();
+
+	if (!clientMtu) {
+		// No clients connected? Ignore write request.
+		return {};
+	}
+
+	if (*clientMtu < PACKET_HEADER_SIZE + 1) {
+		Print* errorLogTarget = BLELedController::GetInstance()->getErrorLogTarget();
+
+		if (errorLogTarget) {
+			errorLogTarget->printf("Cannot send data, need at least 10 bytes MTU but reported client MTU is %u\n", *clientMtu);
+		}
+
+		return {};
+	}
+
+	return clientMtu;
+}
+
+std::vector<uint8_t> WebGUIHandler::CreatePacketHeader(GUIServerHeader headByte, uint32_t requestId, size_t contentLength) {
+	std::vector<uint8_t> header(PACKET_HEADER_SIZE);
+	WritePacketHeader(header.data(), headByte, requestId, contentLength);
+
+	return header;
+}
+
+void WebGUIHandler::WritePacketHeader(uint8_t* target, GUIServerHeader headByte, uint32_t requestId, size_t contentLength) {
+	target[0] = static_cast<uint8_t>(headByte);
+	PokeUInt32(target + 1, htonl(requestId));
+	PokeUInt32(target + 5, htonl(contentLength));
+}
+
+bool WebGUIHandler::IsInSubtree(std::string_view path, std::string_view subtree) {
+	if (path.substr(0, subtree.size()) != subtree)
+		return false;
+
+	return path.size() == subtree.size() || path[subtree.size()] == ',';
+}
+
+bool WebGUIHandler::IsInSubtrees(std::string_view path, const std::vector<std::string>& subtrees) {
+	for (const std::string& subtree : subtrees) {
+		if (IsInSubtree(path, subtree))
+			return true;
+	}
+
+	return false;
+}
+
+std::string WebGUIHandler::ConcatPath(const std::vector<std::string>& path) {
+	std::string result;
+
+	for (size_t i = 0; i < path.size(); ++i) {
+		result += path[i];
 
 		if (i + 1 < path.size()) {
 			result += ',';
@@ -346,3 +1243,184 @@ std::string WebGUIHandler::ConcatPath(const std::vector<std::string>& path) {
 
 	return result;
 }
+
+void WebGUIHandler::AppendEncodedValue(std::vector<uint8_t>& target, const webgui::Value& value) {
+	using ValueType = webgui::ValueType;
+
+	target.push_back(uint8_t(value.getType()));
+
+	switch (value.getType()) {
+		case ValueType::Int32: {
+			size_t offset = target.size();
+			target.resize(offset + 4);
+			PokeUInt32(target.data() + offset, htonl(value.getAsInt32()));
+			break;
+		}
+
+		case ValueType::Boolean: {
+			target.push_back(value.getAsBool());
+			break;
+		}
+
+		case ValueType::String: {
+			AppendLengthPrefixedString(target, std::get<std::string>(value.storage));
+			break;
+		}
+
+		case ValueType::RGBWColor: {
+			RGBW color = value.getAsRGBW();
+
+			target.push_back(color.w);
+			target.push_back(color.r);
+			target.push_back(color.g);
+			target.push_back(color.b);
+			break;
+		}
+
+		case ValueType::Float32: {
+			size_t offset = target.size();
+			target.resize(offset + 4);
+			PokeFloat32(target.data() + offset, htonf(value.getAsFloat32()));
+			break;
+		}
+	}
+}
+
+size_t WebGUIHandler::GetEncodedValueSize(const webgui::Value& value) {
+	using ValueType = webgui::ValueType;
+
+	switch (value.getType()) {
+		case ValueType::Int32:
+		case ValueType::RGBWColor:
+		case ValueType::Float32:
+			return 5;
+		case ValueType::Boolean:
+			return 2;
+		case ValueType::String:
+			return 5 + std::get<std::string>(value.storage).size();
+	}
+
+	return 1;
+}
+
+void WebGUIHandler::AppendCompactValue(std::vector<uint8_t>& target, uint16_t elementId, const webgui::Value& value, std::optional<int32_t> delta) {
+	using ValueType = webgui::ValueType;
+
+	AppendVarUInt(target, elementId);
+
+	switch (value.getType()) {
+		case ValueType::Int32: {
+			target.push_back(uint8_t(value.getType()) | (delta ? COMPACT_VALUE_DELTA : 0));
+			AppendVarUInt(target, ZigZagEncode(delta ? *delta : value.getAsInt32()));
+			break;
+		}
+
+		case ValueType::String: {
+			const std::string& str = std::get<std::string>(value.storage);
+
+			target.push_back(uint8_t(value.getType()));
+			AppendVarUInt(target, str.size());
+			target.insert(target.end(), str.begin(), str.end());
+			break;
+		}
+
+		case ValueType::Boolean:
+		case ValueType::RGBWColor:
+		case ValueType::Float32: {
+			// Same as the regular encoding
+			AppendEncodedValue(target, value);
+			break;
+		}
+	}
+}
+
+size_t WebGUIHandler::GetCompactValueSize(uint16_t elementId, const webgui::Value& value, std::optional<int32_t> delta) {
+	using ValueType = webgui::ValueType;
+
+	size_t size = GetVarUIntSize(elementId);
+
+	switch (value.getType()) {
+		case ValueType::Int32:
+			return size + 1 + GetVarUIntSize(ZigZagEncode(delta ? *delta : value.getAsInt32()));
+		case ValueType::String: {
+			size_t length = std::get<std::string>(value.storage).size();
+			return size + 1 + GetVarUIntSize(length) + length;
+		}
+		case ValueType::Boolean:
+		case ValueType::RGBWColor:
+		case ValueType::Float32:
+			return size + GetEncodedValueSize(value);
+	}
+
+	return size + 1;
+}
+
+std::optional<webgui::Value> WebGUIHandler::DecodeValue(const uint8_t* content, size_t length, size_t& valueLength) {
+	if (length < 1) {
+		return {};
+	}
+
+	using ValueType = webgui::ValueType;
+
+	ValueType type = static_cast<ValueType>(content[0]);
+
+	switch (type) {
+		case ValueType::Int32: {
+			if (length < 5) {
+				return {};
+			}
+
+			valueLength = 5;
+			return webgui::Value(int32_t(ntohl(PeekUInt32(content + 1))));
+		}
+
+		case ValueType::Boolean: {
+			if (length < 2) {
+				return {};
+			}
+
+			valueLength = 2;
+			return webgui::Value(bool(PeekUInt8(content + 1)));
+		}
+
+		case ValueType::String: {
+			if (length < 5) {
+				return {};
+			}
+
+			uint32_t strLength = ntohl(PeekUInt32(content + 1));
+
+			if (length - 5 < strLength) {
+				Serial.printf("Ignore string value, as the content is too small, data length: %u bytes, string length: %" PRIu32 " bytes\n", length, strLength);
+				return {};
+			}
+
+			valueLength = 5 + strLength;
+			return webgui::Value(std::string_view(reinterpret_cast<const char*>(content + 5), strLength));
+		}
+
+		case ValueType::RGBWColor: {
+			if (length < 5) {
+				return {};
+			}
+
+			uint8_t wrgbBytes[4];
+			memcpy(wrgbBytes, content + 1, 4);
+
+			valueLength = 5;
+			return webgui::Value(RGBW(wrgbBytes[1], wrgbBytes[2], wrgbBytes[3], wrgbBytes[0]));
+		}
+
+		case ValueType::Float32: {
+			if (length < 5) {
+				return {};
+			}
+
+			valueLength = 5;
+			return webgui::Value(ntohf(PeekFloat32(content + 1)));
+		}
+	}
+
+	Serial.printf("Unhandled value data type: %" PRIu32 "\n", uint32_t(type));
+	return {};
+}
@@ -5,43 +5,425 @@
 
 #include "AsyncBLECharacteristicWriter.h"
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
 class WebGUIHandler : public BLECharacteristicCallbacks {
 	private:
-		std::shared_ptr<webgui::RootElement> guiRoot;
+		std::shared_ptr<webgui::IGUIModel> guiModel;
 
 		AsyncBLECharacteristicWriter guiDataSendQueue;
 
+		// Called with the connection handle for every request of a client
+		std::function<void(uint16_t conHandle)> onClientRequestCallback;
+
+		// Send value/flag updates with the numeric element id instead of the path
+		bool useElementIds;
+
+		// Send the periodic values as UpdateValuesCompact packets
+		bool compactTelemetry;
+
+		// Reused buffer for value and flag updates (header + content), so sending them does not allocate.
+		// Guarded by the mutex, updates are send from the BLE task (echo) and the application task.
+		// The send queue is never waited for while the mutex is locked, see waitForSendQueue().
+		std::mutex packetMutex;
+		std::vector<uint8_t> packetBuffer;
+
+		/**
+		 * Open value batch of a task, see beginValueBatch().
+		 */
+		struct ValueBatch {
+			TaskHandle_t task;
+			// Nesting depth
+			uint16_t depth;
+			// Elements changed in the batch
+			std::vector<uint16_t> elementIds;
+		};
+
+		// Guarded by the packetMutex, usually one (client transaction or application)
+		std::vector<ValueBatch> valueBatches;
+
+		/**
+		 * Last Int32 value of an element send in a compact packet, the next values are send as delta.
+		 */
+		struct CompactValueBase {
+			int32_t value;
+			// Deltas send since the last absolute value
+			uint8_t deltaCount;
+		};
+
+		// By element id, guarded by the packetMutex. Reset for new subscribers, which need absolute values first.
+		std::vector<std::optional<CompactValueBase>> compactValueBases;
+		// Bases of the compact packet in the packetBuffer, applied once it was queued
+		std::vector<std::pair<uint16_t, CompactValueBase>> compactPacketBases;
+
+		// Task which runs the BLE callbacks (NimBLE host task), it must not wait for the send queue
+		std::atomic<TaskHandle_t> bleHostTask;
+
+		// Subtrees (absolute paths) hidden by each client, value updates inside are not send to the client
+		std::mutex subscriptionMutex;
+		std::map<uint16_t, std::vector<std::string>> hiddenSubtrees;
+
+		/**
+		 * Data of a reliable transfer, the resumes of the client are served from the same snapshot.
+		 */
+		struct TransferSnapshot {
+			std::shared_ptr<const std::vector<uint8_t>> data;
+			uint32_t crc;
+			// Stops the chunk source of the latest request, when the client replaces it
+			std::shared_ptr<std::atomic<bool>> cancelled;
+		};
+
+		// By connection and request type, guarded by the subscriptionMutex. Kept until the client unsubscribes.
+		std::map<std::pair<uint16_t, uint8_t>, TransferSnapshot> transferSnapshots;
+
+		/**
+		 * Publish state of an element with a publish interval, only used by the telemetry thread.
+		 */
+		struct TelemetryState {
+			// Time (millis()) of the last sample, empty before the first one
+			std::optional<unsigned long> lastSample;
+			// Last published value, unchanged values are not send again
+			std::optional<webgui::Value> lastValue;
+		};
+
+		// By element id, grows with GUIs which are extended at runtime
+		std::vector<TelemetryState> telemetryStates;
+		std::vector<uint16_t> telemetryElementIds;
+
+		/**
+		 * StreamUpdates benchmark, send by the telemetry thread.
+		 */
+		struct BenchmarkStream {
+			uint32_t requestId;
+			uint32_t count;
+			uint16_t contentSize;
+			uint16_t intervalMs;
+		};
+
+		// Requested benchmark, guarded by the telemetryMutex. A new request stops the running benchmark.
+		std::optional<BenchmarkStream> pendingBenchmarkStream;
+
+		// The telemetry thread is started on demand, when there are elements with a publish interval or a benchmark stream
+		bool telemetryThreadShouldExit;
+		std::atomic<bool> telemetryThreadStarted;
+		std::mutex telemetryMutex;
+		std::condition_variable telemetryConditionVariable;
+		std::thread telemetryThread;
+
+		/**
+		 * Starts the telemetry thread, when it is not running yet. The Locked variant requires the telemetryMutex to be locked.
+		 */
+		void startTelemetryThread();
+		void startTelemetryThreadLocked();
+
+		/**
+		 * \returns the open value batch of the calling task, nullptr when there is none. The packetMutex must be locked.
+		 */
+		ValueBatch* findValueBatch();
+
+		/**
+		 * \returns true when any element has a publish interval.
+		 */
+		bool hasPublishIntervals() const;
+
+		void TelemetryThreadFunc();
+
+		/**
+		 * Samples the elements which are due, the changed ones are collected in the telemetryElementIds.
+		 * Called with the telemetryMutex locked.
+		 * \returns the time (ms) until the next element is due.
+		 */
+		uint32_t sampleTelemetry();
+
+		/**
+		 * Sends the values of the telemetryElementIds as one batch, called without the telemetryMutex.
+		 */
+		void publishTelemetry();
+
 		NimBLECharacteristic& getCharacteristic();
 
-		void handleGUIRequest(BLECharacteristic& characteristic);
-		void handleGUISetValueRequest(uint32_t requestId, const std::vector<uint8_t>& content);
+		void handleGUIRequest(BLECharacteristic& characteristic, uint16_t conHandle);
+		void handleGUISetValueRequest(uint32_t requestId, const uint8_t* content, size_t length);
+		void handleGUISetValueByIdRequest(uint32_t requestId, const uint8_t* content, size_t length);
+
+		/**
+		 * Applies a transaction of values (element id + value records) from a client.
+		 * Either all values are set or none, followed by one commit notification and the echo of the values with the request id.
+		 * The echo is one UpdateValues packet, unless the values don't fit into one chunk or are hidden by different clients:
+		 * then it is split into several UpdateValues packets, values which don't fit into a chunk at all follow as UpdateValue packets.
+		 * Values changed by the application callbacks (on the BLE task) during the transaction are send afterwards, as broadcast.
+		 */
+		void handleGUISetValuesRequest(uint32_t requestId, const uint8_t* content, size_t length);
+
+		/**
+		 * \returns true (and logs it) when the element is read only and must not be changed by clients.
+		 */
+		bool isReadOnlyElement(uint16_t elementId) const;
+
+		/**
+		 * Starts a reliable transfer of the binary GUI description or the values (request type + offset),
+		 * send as TransferSegment packets from the requested offset to the end, only to the requesting client.
+		 * A transfer from offset 0 takes a new snapshot of the data, a resume continues the snapshot of the previous request.
+		 * The request replaces the previous transfer of the type, its remaining segments are not send anymore.
+		 */
+		void handleGUITransferRequest(uint16_t conHandle, uint32_t requestId, const uint8_t* content, size_t length);
+
+		/**
+		 * Shows or hides a subtree (visible flag + path) for the requesting client.
+		 * The current values of a shown subtree are send again to the client, it missed the updates while it was hidden.
+		 */
+		void handleGUISetSubtreeVisibleRequest(uint16_t conHandle, const uint8_t* content, size_t length);
+
+		/**
+		 * Starts a benchmark (benchmark type + parameters, see GUIBenchmarkType), the replies go through the regular send queue.
+		 * Pings are echoed directly, streams are send from the chunk source (StreamBytes) or by the telemetry thread (StreamUpdates).
+		 */
+		void handleGUIBenchmarkRequest(uint32_t requestId, const uint8_t* content, size_t length);
+
+		/**
+		 * Sends the update packets of a StreamUpdates benchmark, the periodic values are not published meanwhile.
+		 * Stops early on a new benchmark request or when the handler is destroyed.
+		 */
+		void writeBenchmarkUpdates(const BenchmarkStream& stream);
+
+		/**
+		 * \returns false when the element is inside a subtree hidden by the client, used as subscriber filter of the send queue.
+		 */
+		bool isElementVisible(uint16_t conHandle, uint16_t elementId);
+
+		/**
+		 * \returns a bit for each client which hides the element (in the order of the hiddenSubtrees),
+		 * the elements in one batch packet must be hidden by the same clients.
+		 */
+		uint32_t getHiddenMask(uint16_t elementId);
+
+		/**
+		 * Parses the value (type + value) from the content, sets it and sends the new value to all clients.
+		 */
+		void handleGUISetElementValue(uint32_t requestId, uint16_t elementId, const uint8_t* content, size_t length);
 
 		void writeGUIInfoDataV1(uint32_t requestId);
-		void writeGUIUpdateValue(uint32_t requestId, const std::vector<std::string>& path, const webgui::AValueWrapper& value);
-		void writeGUIUpdateValue(uint32_t requestId, const std::string& name, const webgui::AValueWrapper& value);
 
-		void writeGUIUpdateFlag(uint32_t requestId, const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState);
-		void writeGUIUpdateFlag(uint32_t requestId, const std::string& name, webgui::GUIFlag flag, bool newState);
+		/**
+		 * Writes the JSON of a subtree (depth + path, an empty path for the whole GUI) behind the structure hash.
+		 * Groups below the depth are placeholders, the client requests them on demand.
+		 * Only the hash is send when the path is unknown.
+		 */
+		void writeGUISubtree(uint32_t requestId, const uint8_t* content, size_t length);
+
+		/**
+		 * Writes the GUI description in the binary schema format, see webgui::BinarySchemaWriter.
+		 */
+		void writeGUIInfoDataBinary(uint32_t requestId);
+
+		/**
+		 * Writes the structure hash of the GUI, clients can reuse a cached GUI description when it matches.
+		 */
+		void writeGUIHash(uint32_t requestId);
+
+		/**
+		 * Writes the structure hash followed by the current values of all elements (element id + value),
+		 * used by clients which already have the GUI description.
+		 */
+		void writeGUIValues(uint32_t requestId);
+
+		/**
+		 * \returns the content of the GUIValues packet, see writeGUIValues().
+		 */
+		std::vector<uint8_t> createGUIValuesContent();
+		void writeGUIUpdateValue(uint32_t requestId, uint16_t elementId, const webgui::Value& value);
+
+		/**
+		 * Sends the current values of the given elements, packed into as few packets as possible (each fits into one chunk).
+		 * Values which do not fit into a single chunk are send as separate update.
+		 * The packetMutex must be locked.
+		 * \param conHandle the only client which receives the values, ALL_SUBSCRIBERS for all
+		 */
+		void writeGUIUpdateValues(uint32_t requestId, const std::vector<uint16_t>& elementIds,
+			AsyncBLECharacteristicWriter::Priority priority = AsyncBLECharacteristicWriter::Priority::Interactive,
+			uint16_t conHandle = AsyncBLECharacteristicWriter::ALL_SUBSCRIBERS);
+		/**
+		 * Sends the current values of the given elements as UpdateValuesCompact packets (each fits into one chunk):
+		 * LEB128 element ids, Int32 values as zig-zag deltas against the last compact value.
+		 * The compact packets are send in the Telemetry queue only, so clients receive the deltas in the order they were computed.
+		 * Every client receives every packet with deltas: the bases only advance for queued packets and elements in subtrees
+		 * hidden by any client (filtered packets) are always send as absolute values.
+		 * The packetMutex must be locked.
+		 */
+		void writeGUIUpdateValuesCompact(const std::vector<uint16_t>& elementIds);
+
+		/**
+		 * \returns the delta of the Int32 value against the last compact value of the element,
+		 * empty when the value must be send as absolute value. The packetMutex must be locked.
+		 */
+		std::optional<int32_t> getCompactDelta(uint16_t elementId, const webgui::Value& value) const;
+		void writeGUIUpdateFlag(uint32_t requestId, uint16_t elementId, webgui::GUIFlag flag, bool newState);
+
+		/**
+		 * Appends the reference to the element, either as numeric id or as length prefixed path
+		 * depending on the useElementIds setting.
+		 */
+		void appendElementReference(std::vector<uint8_t>& target, uint16_t elementId) const;
+
+		/**
+		 * \returns the size of the element reference, see appendElementReference().
+		 */
+		size_t getElementReferenceSize(uint16_t elementId) const;
 
 		/**
 		 * Writes a block of data to the characteristic. When the data is longer then the transmission size, it will be split
 		 * into several parts. The receiver can handle this by the prefixed length information.
 		 */
-		void writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const std::vector<uint8_t>& data);
-		void writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const uint8_t* data, size_t length);
+		void writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const std::vector<uint8_t>& data,
+			AsyncBLECharacteristicWriter::Priority priority = AsyncBLECharacteristicWriter::Priority::Interactive);
+		void writeCharacteristicData(GUIServerHeader headByte, uint32_t requestId, const uint8_t* data, size_t length,
+			AsyncBLECharacteristicWriter::Priority priority = AsyncBLECharacteristicWriter::Priority::Interactive);
+
+		/**
+		 * Completes the header of the packet in the packetBuffer and sends it.
+		 * The packetBuffer must start with PACKET_HEADER_SIZE bytes, followed by the content.
+		 *
+		 * Pending broadcasts with the same coalesce key are replaced by this packet, when it fits into one slot of the send queue.
+		 * Replies to a client request are never replaced, the client waits for its request id.
+		 * \returns false when the packet was not queued (no subscribers or the send queue is full).
+		 */
+		bool writePacketBuffer(GUIServerHeader headByte, uint32_t requestId, uint32_t coalesceKey = AsyncBLECharacteristicWriter::NO_COALESCE_KEY,
+			AsyncBLECharacteristicWriter::Priority priority = AsyncBLECharacteristicWriter::Priority::Interactive,
+			uint32_t filterKey = AsyncBLECharacteristicWriter::NO_FILTER_KEY, uint16_t conHandle = AsyncBLECharacteristicWriter::ALL_SUBSCRIBERS);
+
+		/**
+		 * Waits until the queue of the priority can take the amount of packets (up to the queue size), except on the BLE host task.
+		 * The BLE host task frees the buffers of send notifications, it appends without waiting (full queues drop the packet,
+		 * pending updates of the same element are replaced). Must be called before the packetMutex is locked.
+		 */
+		void waitForSendQueue(AsyncBLECharacteristicWriter::Priority priority, size_t packetCount = 1);
+
+		/**
+		 * \returns true when there are clients to send data to.
+		 */
+		bool hasSubscribers();
+
+		/**
+		 * \returns the smallest chunk size of all subscribed clients, empty when sending is not possible.
+		 * Packets are chunked by the writer for each connection, only packets which must arrive in one notification
+		 * (batched updates) are limited to this size.
+		 */
+		std::optional<uint16_t> getSendChunkSize();
+
+		/**
+		 * Creates the header in front of every server packet: head byte, request id and content length.
+		 */
+		static std::vector<uint8_t> CreatePacketHeader(GUIServerHeader headByte, uint32_t requestId, size_t contentLength);
+		static void WritePacketHeader(uint8_t* target, GUIServerHeader headByte, uint32_t requestId, size_t contentLength);
+
+		/**
+		 * \returns true when the element path is the subtree or inside of it.
+		 */
+		static bool IsInSubtree(std::string_view path, std::string_view subtree);
+
+		/**
+		 * \returns true when the element path is one of the subtrees or inside of them.
+		 */
+		static bool IsInSubtrees(std::string_view path, const std::vector<std::string>& subtrees);
 
 		/**
 		 * Concats the given path into the string representation.
 		 */
 		static std::string ConcatPath(const std::vector<std::string>& path);
 
+		/**
+		 * Appends the value type + value in the network representation.
+		 */
+		static void AppendEncodedValue(std::vector<uint8_t>& target, const webgui::Value& value);
+
+		/**
+		 * \returns the size of the encoded value, see AppendEncodedValue().
+		 */
+		static size_t GetEncodedValueSize(const webgui::Value& value);
+
+		/**
+		 * Appends the compact value record (LEB128 element id, value type + value), see writeGUIUpdateValuesCompact().
+		 */
+		static void AppendCompactValue(std::vector<uint8_t>& target, uint16_t elementId, const webgui::Value& value, std::optional<int32_t> delta);
+
+		/**
+		 * \returns the size of the compact value record, see AppendCompactValue().
+		 */
+		static size_t GetCompactValueSize(uint16_t elementId, const webgui::Value& value, std::optional<int32_t> delta);
+
+		/**
+		 * Decodes the value type + value from the network representation.
+		 * \param valueLength set to the amount of bytes used by the value
+		 * \returns the value, empty when the content is invalid
+		 */
+		static std::optional<webgui::Value> DecodeValue(const uint8_t* content, size_t length, size_t& valueLength);
+
 	public:
-		WebGUIHandler(std::shared_ptr<webgui::RootElement> guiRoot, BLEService* pService);
+		WebGUIHandler(std::shared_ptr<webgui::IGUIModel> guiModel, BLEService* pService);
 		~WebGUIHandler();
 
+		/**
+		 * \returns the id of the element with the absolute path (comma separated), webgui::INVALID_ELEMENT_ID when the path is unknown.
+		 * Resolve the id once and use the id based calls on hot paths.
+		 */
+		uint16_t findElementId(std::string_view path) const;
+
+		/**
+		 * Same as findElementId() with the path segments, does not allocate memory for paths up to 128 characters.
+		 */
+		uint16_t findElementId(const std::vector<std::string>& path) const;
+
+		/**
+		 * Sends the current value of the element to all clients.
+		 * Elements with a publish interval are send by the telemetry thread instead, at most once per interval.
+		 */
 		bool notifyGUIValueChange(const std::vector<std::string>& path);
+		bool notifyGUIValueChange(uint16_t elementId);
+		/**
+		 * Starts collecting the value changes (notifyGUIValueChange()) of the calling task instead of sending them directly.
+		 * Batches can be nested, the values are send when the outermost batch is committed.
+		 * Each task has its own batch, notifications of other tasks are send directly meanwhile.
+		 */
+		void beginValueBatch();
+
+		/**
+		 * Sends the latest values of all elements changed since the batch was started, packed into few packets.
+		 */
+		void commitValueBatch();
+
 		bool setGUIElementFlag(const std::vector<std::string>& path, webgui::GUIFlag flag, bool newState);
+		bool setGUIElementFlag(uint16_t elementId, webgui::GUIFlag flag, bool newState);
+
+		/**
+		 * Enables sending value and flag updates with the numeric element id instead of the path.
+		 * Requires clients which support the UpdateValueById and UpdateFlagById packets.
+		 */
+		void setUseElementIds(bool enabled);
+
+		/**
+		 * Enables interleaving of split packets, value updates are then send in between the chunks of GUI downloads.
+		 * Requires clients which support the StreamChunk packet.
+		 */
+		void setInterleavePackets(bool enabled);
+
+		/**
+		 * Sends the periodic values (see IGUIModel::getElementPublishIntervalById()) in the compact encoding.
+		 * Requires clients which support the UpdateValuesCompact packet.
+		 */
+		void setCompactTelemetry(bool enabled);
+
+		/**
+		 * Sets the callback which is invoked (from the BLE task) for every request of a client.
+		 */
+		void setOnClientRequestCallback(std::function<void(uint16_t conHandle)> callback);
 
-		virtual void onWrite(BLECharacteristic* pCharacteristic/*, esp_ble_gatts_cb_param_t* param*/) override;
+		virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) override;
 		virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue) override;
 };
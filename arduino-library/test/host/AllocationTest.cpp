@@ -0,0 +1,191 @@
+/**
+ * Host test of the SetValue / UpdateValue hot path: After the handler is set up and a client subscribed,
+ * handling value changes must not allocate memory (see WebGUIHandler::handleGUIRequest()).
+ *
+ * Only the allocations of the test thread are counted, the send thread of the queue copies the chunks
+ * into the mbufs of NimBLE, which come from its own pool.
+ */
+#include "HostStubs.h"
+
+#include "gui/WebGUIHandler.h"
+
+#include <arpa/inet.h>
+
+#include <cstdlib>
+#include <new>
+
+static thread_local bool countAllocations = false;
+static thread_local size_t allocationCount = 0;
+
+void* operator new(size_t size) {
+	if (countAllocations) {
+		allocationCount++;
+	}
+
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+static int failedChecks = 0;
+
+static void Check(bool condition, const char* description) {
+	if (!condition) {
+		failedChecks++;
+	}
+
+	printf("%s: %s\n", condition ? "OK  " : "FAIL", description);
+}
+
+/**
+ * Runs the function and checks that the calling thread did not allocate memory.
+ */
+template <typename Function>
+static void CheckNoAllocations(const char* description, Function function) {
+	allocationCount = 0;
+	countAllocations = true;
+
+	function();
+
+	countAllocations = false;
+
+	if (allocationCount > 0) {
+		printf("  %zu allocations\n", allocationCount);
+	}
+
+	Check(allocationCount == 0, description);
+}
+
+static void AppendUInt32(std::vector<uint8_t>& target, uint32_t value) {
+	uint32_t networkValue = htonl(value);
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&networkValue);
+	target.insert(target.end(), bytes, bytes + 4);
+}
+
+static std::vector<uint8_t> CreateSetValueRequest(uint32_t requestId, std::string_view path, int32_t value) {
+	std::vector<uint8_t> request = {uint8_t(GUIClientHeader::SetValue)};
+	AppendUInt32(request, requestId);
+	AppendUInt32(request, path.size());
+	request.insert(request.end(), path.begin(), path.end());
+	request.push_back(uint8_t(webgui::ValueType::Int32));
+	AppendUInt32(request, value);
+
+	return request;
+}
+
+static std::vector<uint8_t> CreateSetValueByIdRequest(uint32_t requestId, uint16_t elementId, int32_t value) {
+	std::vector<uint8_t> request = {uint8_t(GUIClientHeader::SetValueById)};
+	AppendUInt32(request, requestId);
+	request.push_back(uint8_t(elementId >> 8));
+	request.push_back(uint8_t(elementId));
+	request.push_back(uint8_t(webgui::ValueType::Int32));
+	AppendUInt32(request, value);
+
+	return request;
+}
+
+/**
+ * Waits until the send thread passed the expected amount of notifications to NimBLE.
+ */
+static bool WaitForNotifications(size_t expectedCount) {
+	for (int i = 0; i < 200 && notificationCount < expectedCount; ++i) {
+		delay(5);
+	}
+
+	return notificationCount >= expectedCount;
+}
+
+int main() {
+	int32_t brightness = 0;
+	int32_t speed = 0;
+
+	auto gui = std::make_shared<webgui::RootElement>();
+	webgui::GroupElement* group = gui->addGroup("Light");
+	group->addRange("Brightness", 0, 255, webgui::RefValueHandler<int32_t>::Create(brightness, nullptr));
+	group->addNumberFieldInt32("Speed", webgui::RefValueHandler<int32_t>::Create(speed, nullptr));
+
+	BLEService service;
+	WebGUIHandler handler(gui, &service);
+	NimBLECharacteristic& characteristic = *service.characteristics.front();
+
+	ble_gap_conn_desc desc = {};
+	desc.conn_handle = 1;
+
+	characteristic.subscribedCount = 1;
+	handler.onSubscribe(&characteristic, &desc, 1);
+
+	const std::vector<std::string> brightnessPath = {"Light", "Brightness"};
+	const uint16_t brightnessId = gui->findElementId("Light,Brightness");
+	const uint16_t speedId = gui->findElementId("Light,Speed");
+
+	std::vector<uint8_t> setValueRequest = CreateSetValueRequest(1, "Light,Brightness", 42);
+	std::vector<uint8_t> setValueByIdRequest = CreateSetValueByIdRequest(2, speedId, 7);
+
+	uint16_t foundId = webgui::INVALID_ELEMENT_ID;
+
+	CheckNoAllocations("findElementId() with the path string", [&] {
+		foundId = handler.findElementId("Light,Brightness");
+	});
+
+	Check(foundId == brightnessId, "element id of the path string");
+
+	CheckNoAllocations("findElementId() with the path segments", [&] {
+		foundId = handler.findElementId(brightnessPath);
+	});
+
+	Check(foundId == brightnessId, "element id of the path segments");
+
+	// NimBLE stores the written value in the attribute before the callback
+	characteristic.setValue(setValueRequest.data(), setValueRequest.size());
+
+	CheckNoAllocations("SetValue request and its echo", [&] {
+		handler.onWrite(&characteristic, &desc);
+	});
+
+	Check(brightness == 42, "SetValue applied");
+	Check(WaitForNotifications(1), "SetValue echoed");
+
+	// NimBLE stores the written value in the attribute before the callback
+	characteristic.setValue(setValueByIdRequest.data(), setValueByIdRequest.size());
+
+	CheckNoAllocations("SetValueById request and its echo", [&] {
+		handler.onWrite(&characteristic, &desc);
+	});
+
+	Check(speed == 7, "SetValueById applied");
+	Check(WaitForNotifications(2), "SetValueById echoed");
+
+	bool notified = false;
+	brightness = 100;
+
+	CheckNoAllocations("notifyGUIValueChange() with the path segments", [&] {
+		notified = handler.notifyGUIValueChange(brightnessPath);
+	});
+
+	Check(notified && WaitForNotifications(3), "value change of the path segments send");
+
+	speed = 8;
+
+	CheckNoAllocations("notifyGUIValueChange() with the element id", [&] {
+		notified = handler.notifyGUIValueChange(speedId);
+	});
+
+	Check(notified && WaitForNotifications(4), "value change of the element id send");
+
+	if (failedChecks > 0) {
+		printf("%d checks failed\n", failedChecks);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include "HostStubs.h"
+
+#include "BLELedController.h"
+
+#include <freertos/task.h>
+
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+std::atomic<size_t> notificationCount(0);
+
+// NimBLE takes the notification buffers from its own mbuf pool, the stub only needs a single one
+static os_mbuf notificationBuffer;
+
+void delay(uint32_t ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+unsigned long millis() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+	static thread_local char taskIdentity;
+	return reinterpret_cast<TaskHandle_t>(&taskIdentity);
+}
+
+os_mbuf* ble_hs_mbuf_from_flat(const void* data, uint16_t length) {
+	notificationBuffer.om_len = length;
+	return &notificationBuffer;
+}
+
+int ble_gatts_notify_custom(uint16_t conHandle, uint16_t attributeHandle, os_mbuf* om) {
+	notificationCount++;
+	return 0;
+}
+
+int ble_gap_conn_find(uint16_t conHandle, ble_gap_conn_desc* desc) {
+	*desc = {};
+	desc->conn_handle = conHandle;
+	desc->conn_itvl = 24;
+	return 0;
+}
+
+int ble_gap_terminate(uint16_t conHandle, uint8_t reason) {
+	return 0;
+}
+
+uint16_t ble_att_mtu(uint16_t conHandle) {
+	return HOST_MTU;
+}
+
+// The library only uses the controller for the client MTU, these members don't access the instance
+BLELedController* BLELedController::GetInstance() {
+	return nullptr;
+}
+
+std::optional<uint16_t> BLELedController::getClientsContentMtu() const {
+	return HOST_MTU - 3;
+}
+
+Print* BLELedController::getErrorLogTarget() const {
+	return nullptr;
+}
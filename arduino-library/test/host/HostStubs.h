@@ -0,0 +1,11 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// ATT MTU reported for every connection
+static constexpr uint16_t HOST_MTU = 247;
+
+// Notifications passed to ble_gatts_notify_custom()
+extern std::atomic<size_t> notificationCount;
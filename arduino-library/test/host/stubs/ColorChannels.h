@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stub of the ColorChannels type of the LedControlAndAnimation library
+
+struct ColorChannels {
+	ColorChannels(const char*) {}
+};
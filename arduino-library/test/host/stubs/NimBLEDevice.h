@@ -0,0 +1,183 @@
+#pragma once
+
+// Host stub of the NimBLE-Arduino API used by the library, the functions are defined in HostStubs.cpp
+// Also includes the headers the library gets from the Arduino framework
+
+#include <arpa/inet.h>
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct Print {
+	int printf(const char* format, ...) {
+		va_list args;
+		va_start(args, format);
+		int result = vfprintf(stdout, format, args);
+		va_end(args);
+		return result;
+	}
+};
+
+struct HardwareSerial : Print {};
+extern HardwareSerial Serial;
+
+void delay(uint32_t ms);
+unsigned long millis();
+
+#define BLE_HS_ENOMEM 6
+#define BLE_HS_ENOTCONN 7
+#define BLE_HS_EBUSY 15
+#define BLE_ATT_MTU_DFLT 23
+#define BLE_ERR_REM_USER_CONN_TERM 0x13
+#define BLE_GAP_LE_PHY_1M_MASK 1
+#define BLE_GAP_LE_PHY_2M_MASK 2
+#define BLE_GAP_LE_PHY_CODED_MASK 4
+#define BLE_GAP_LE_PHY_CODED_ANY 0
+
+struct os_mbuf {
+	uint16_t om_len;
+};
+
+struct ble_addr_t {
+	uint8_t val[6];
+};
+
+struct ble_gap_conn_desc {
+	uint16_t conn_handle;
+	ble_addr_t peer_ota_addr;
+	uint16_t conn_itvl;
+	uint16_t conn_latency;
+	uint16_t supervision_timeout;
+};
+
+struct ble_gap_upd_params {
+	uint16_t itvl_min;
+	uint16_t itvl_max;
+	uint16_t latency;
+	uint16_t supervision_timeout;
+	uint16_t min_ce_len;
+	uint16_t max_ce_len;
+};
+
+os_mbuf* ble_hs_mbuf_from_flat(const void* data, uint16_t length);
+int ble_gatts_notify_custom(uint16_t conHandle, uint16_t attributeHandle, os_mbuf* om);
+int ble_gap_conn_find(uint16_t conHandle, ble_gap_conn_desc* desc);
+int ble_gap_terminate(uint16_t conHandle, uint8_t reason);
+int ble_gap_update_params(uint16_t conHandle, const ble_gap_upd_params* params);
+int ble_gap_set_prefered_le_phy(uint16_t conHandle, uint8_t txPhys, uint8_t rxPhys, uint16_t phyOptions);
+int ble_gap_set_data_len(uint16_t conHandle, uint16_t txOctets, uint16_t txTime);
+uint16_t ble_att_mtu(uint16_t conHandle);
+
+/**
+ * View on the attribute value, like the NimBLEAttValue it does not copy the data.
+ */
+struct NimBLEAttValue {
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+
+	const uint8_t* data() const {
+		return bytes;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	const uint8_t* begin() const {
+		return bytes;
+	}
+
+	const uint8_t* end() const {
+		return bytes + length;
+	}
+
+	uint8_t operator[](size_t index) const {
+		return bytes[index];
+	}
+};
+
+struct BLEUUID {
+	BLEUUID(const char*) {}
+	BLEUUID(const std::string&) {}
+
+	std::string toString() const {
+		return {};
+	}
+};
+
+struct NimBLECharacteristic;
+
+struct NimBLECharacteristicCallbacks {
+	virtual ~NimBLECharacteristicCallbacks() = default;
+
+	virtual void onWrite(NimBLECharacteristic*) {}
+	virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc*) {
+		onWrite(pCharacteristic);
+	}
+	virtual void onSubscribe(NimBLECharacteristic*, ble_gap_conn_desc*, uint16_t) {}
+	virtual void onStatus(NimBLECharacteristic*, int) {}
+};
+
+/**
+ * Characteristic with the value written by a client and the subscriber count.
+ */
+struct NimBLECharacteristic {
+	std::vector<uint8_t> value;
+	size_t subscribedCount = 0;
+	NimBLECharacteristicCallbacks* pCallbacks = nullptr;
+
+	uint16_t getHandle() const {
+		return 1;
+	}
+
+	size_t getDataLength() {
+		return value.size();
+	}
+
+	NimBLEAttValue getValue() {
+		return {value.data(), value.size()};
+	}
+
+	void setValue(const uint8_t* data, size_t length) {
+		value.assign(data, data + length);
+	}
+
+	void setCallbacks(NimBLECharacteristicCallbacks* callbacks) {
+		pCallbacks = callbacks;
+	}
+
+	size_t getSubscribedCount() {
+		return subscribedCount;
+	}
+};
+
+namespace NIMBLE_PROPERTY {
+	enum {
+		READ = 1,
+		WRITE = 2,
+		NOTIFY = 4,
+		WRITE_NR = 8,
+	};
+}
+
+struct NimBLEService {
+	std::vector<std::unique_ptr<NimBLECharacteristic>> characteristics;
+
+	NimBLECharacteristic* createCharacteristic(const BLEUUID&, uint32_t) {
+		return characteristics.emplace_back(std::make_unique<NimBLECharacteristic>()).get();
+	}
+};
+
+typedef NimBLECharacteristic BLECharacteristic;
+typedef NimBLECharacteristicCallbacks BLECharacteristicCallbacks;
+typedef NimBLEService BLEService;
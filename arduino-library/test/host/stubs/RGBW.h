@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Host stub of the RGBW type of the LedControlAndAnimation library
+
+struct RGBW {
+	uint8_t r = 0;
+	uint8_t g = 0;
+	uint8_t b = 0;
+	uint8_t w = 0;
+
+	RGBW() = default;
+
+	RGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w) :
+		r(r),
+		g(g),
+		b(b),
+		w(w) {}
+
+	explicit RGBW(uint32_t packedColor) :
+		r(packedColor >> 16),
+		g(packedColor >> 8),
+		b(packedColor),
+		w(packedColor >> 24) {}
+
+	uint32_t getAsPackedColor() const {
+		return (uint32_t(w) << 24) | (uint32_t(r) << 16) | (uint32_t(g) << 8) | b;
+	}
+
+	bool operator==(const RGBW& other) const {
+		return getAsPackedColor() == other.getAsPackedColor();
+	}
+
+	bool operator!=(const RGBW& other) const {
+		return !(*this == other);
+	}
+};
+
+static const RGBW COLOR_OFF;
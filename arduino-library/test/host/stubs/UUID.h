@@ -0,0 +1,14 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Host stub of the UUID library
+
+struct UUID {
+	std::array<uint8_t, 16> bytes = {};
+
+	bool operator<(const UUID& other) const {
+		return bytes < other.bytes;
+	}
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stub of the FreeRTOS types used by the library
+
+struct tskTaskControlBlock;
+typedef tskTaskControlBlock* TaskHandle_t;
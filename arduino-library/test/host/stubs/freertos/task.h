@@ -0,0 +1,8 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+/**
+ * \returns a handle unique for the calling thread.
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle();
@@ -0,0 +1,4 @@
+#pragma once
+
+// htonl() and friends
+#include <arpa/inet.h>
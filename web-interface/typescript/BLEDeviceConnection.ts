@@ -7,6 +7,9 @@ class BLEDeviceConnection extends UIGroupElement {
 	ledInfoChangeHandler: (event: Event) => void;
 	ledInfoCharacteristic: BluetoothRemoteGATTCharacteristic | undefined;
 	guiControl: GUIProtocolHandler | undefined;
+	benchmarkPage: BenchmarkPage | undefined;
+	// Top level elements created from the GUI description, replaced when a new description arrives
+	guiElementNames: string[];
 	connectingAnimationElement: HTMLDivElement | null;
 
 	classicCharacteristicMapping: Map<string, BluetoothRemoteGATTCharacteristic>;
@@ -18,6 +21,7 @@ class BLEDeviceConnection extends UIGroupElement {
 		this.modelName = null;
 
 		this.classicCharacteristicMapping = new Map();
+		this.guiElementNames = [];
 		this.buttonDisconnect = HTML.CreateButtonElement('Disconnect');
 		this.disconnectHandler = () => {this.disconnect();};
 		this.connectionFailedHandler = (err) => {this._connectionFailed(err);}
@@ -44,6 +48,11 @@ class BLEDeviceConnection extends UIGroupElement {
 	override destroy() {
 		this.device.removeEventListener('gattserverdisconnected', this.disconnectHandler);
 
+		if (this.benchmarkPage) {
+			this.benchmarkPage.close();
+			this.benchmarkPage = undefined;
+		}
+
 		if (this.ledInfoCharacteristic) {
 			this.ledInfoCharacteristic.removeEventListener('characteristicvaluechanged', this.ledInfoChangeHandler);
 		}
@@ -132,6 +141,30 @@ class BLEDeviceConnection extends UIGroupElement {
 		Log("Unhandled input event from element: " + sourceAbsoluteName);
 	}
 
+	override onVisibilityChange(sourceElement: AUIElement, visible: boolean) {
+		if (this.guiControl) {
+			this.guiControl.setSubtreeVisible(sourceElement.getAbsoluteName().slice(1), visible);
+		}
+	}
+
+	/**
+	 * Changes several values of the device GUI at once (e.g. a preset), the path is relative to the device.
+	 */
+	setRemoteValues(values: [string[], ValueWrapper][]) {
+		const guiControl = this.guiControl;
+
+		if (!guiControl) {
+			Log("Unable to set values, the device has no GUI");
+			return;
+		}
+
+		if (guiControl.setValues(values))
+			return;
+
+		// Device without transaction support
+		values.forEach(([remoteName, newValue]) => guiControl.setValue(remoteName, newValue));
+	}
+
 	private _handleClassicCharacteristicMapping(absoluteName: string[], sourceElement: AUIElement, newValue: ValueWrapper) : boolean {
 		const entry = this.classicCharacteristicMapping.get(absoluteName.toString());
 
@@ -171,10 +204,25 @@ class BLEDeviceConnection extends UIGroupElement {
 				// Remove connecting animation
 				this._removeConnectingAnimation();
 
+				// A cached GUI description may be replaced by the current one, remove the old controls
+				this.guiElementNames.forEach(name => this.removeChildByName(name));
+				this.guiElementNames = (<RootDataJSON>json).elements.map(entry => entry.name);
+
 				// Process received GUI-JSON and construct the GUI controls
 				ProcessJSON(this, json);
 			}
 
+			const handleSubtreeJsonFunction = (path: string[], json: GroupDataJSON) => {
+				const group = this.getByPath([this.getName()].concat(path));
+
+				if (!(group instanceof UIGroupElement)) {
+					throw "UI group for path '" + path + "' not found";
+				}
+
+				// Fill the placeholder group
+				json.elements.forEach(entry => ProcessJSON(group, entry));
+			}
+
 			const handleUpdateValueFunction = (path: string[], newValue: ValueWrapper) => {
 				const completePath : string[] = [this.getName()].concat(path);
 
@@ -192,7 +240,15 @@ class BLEDeviceConnection extends UIGroupElement {
 				targetElem.setFlag(flag, newState);
 			}
 
-			this.guiControl = new GUIProtocolHandler(characteristic, handleJsonFunction, handleUpdateValueFunction, handleFlagUpdateFunction);
+			this.guiControl = new GUIProtocolHandler(characteristic, this.device.id, handleJsonFunction, handleSubtreeJsonFunction, handleUpdateValueFunction, handleFlagUpdateFunction);
+
+			const buttonBenchmark = this.addToGroupHeader(HTML.CreateButtonElement('Benchmark'));
+
+			buttonBenchmark.onclick = () => {
+				if (this.guiControl) {
+					this.benchmarkPage = new BenchmarkPage(this.getName(), this.guiControl, () => {this.benchmarkPage = undefined;});
+				}
+			}
 		}
 	}
 
@@ -1,10 +1,13 @@
 class PendingDataEntry {
 	groupName: string;
 	data: Uint8Array;
+	// Write with response allows data larger than the MTU (long write)
+	withResponse: boolean;
 
-	constructor(groupName: string, data: Uint8Array) {
+	constructor(groupName: string, data: Uint8Array, withResponse: boolean) {
 		this.groupName = groupName;
 		this.data = data;
+		this.withResponse = withResponse;
 	}
 }
 
@@ -27,14 +30,15 @@ class BLEDataWriter {
 		this.failedRepeatCount = 0;
 	}
 
-	sendData(groupName: string, data: Uint8Array) {
+	sendData(groupName: string, data: Uint8Array, withResponse: boolean = false) {
 		const noOperationPending = this.pendingData.length === 0;
 
-		const entry = new PendingDataEntry(groupName, data);
+		const entry = new PendingDataEntry(groupName, data, withResponse);
 
 		if (this.pendingData.length > 0 && this.pendingData[0].groupName === groupName) {
 			// Try to send data with the same content, replace the entry for next send operation
 			this.pendingData[0].data = data;
+			this.pendingData[0].withResponse = withResponse;
 			return;
 		}
 
@@ -48,9 +52,12 @@ class BLEDataWriter {
 	private _sendData() {
 		const obj = this;
 		const sendData = this.pendingData[0].data;
+		const withResponse = this.pendingData[0].withResponse;
 
 		const reqSendFunction = function(characteristic: BluetoothRemoteGATTCharacteristic, data: Uint8Array) {
-			characteristic.writeValueWithoutResponse(data).then(_ => {
+			const writePromise = withResponse ? characteristic.writeValueWithResponse(data) : characteristic.writeValueWithoutResponse(data);
+
+			writePromise.then(_ => {
 				if (obj.pendingData[0].data === sendData) {
 					// Only remove the entry when the content was not replaced in the meantime
 					obj.pendingData.shift();
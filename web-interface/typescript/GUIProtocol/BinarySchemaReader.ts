@@ -0,0 +1,145 @@
+/**
+ * Element types of the binary GUI schema, see BinarySchemaWriter.h of the arduino library.
+ */
+enum BinaryElementType {
+	Root = 0,
+	Group = 1,
+	Range = 2,
+	Checkbox = 3,
+	Radio = 4,
+	DropDown = 5,
+	Button = 6,
+	NumberFieldInt32 = 7,
+	TextField = 8,
+	PasswordField = 9,
+	RGBWRange = 10,
+	Compass = 11,
+}
+
+const BINARY_FLAG_ADVANCED = 0x01;
+const BINARY_FLAG_READ_ONLY = 0x02;
+const BINARY_FLAG_COLLAPSABLE = 0x04;
+const BINARY_FLAG_COLLAPSED = 0x08;
+
+const BINARY_INVALID_ELEMENT_ID = 0xFFFF;
+
+/**
+ * Decodes the binary GUI schema into the same structure as the JSON GUI description,
+ * so it can be processed by ProcessJSON().
+ */
+function DecodeBinarySchema(data: DataView) : ADataJSON | null {
+	const reader = new NetworkBufferReader(data);
+	return DecodeBinarySchemaElement(reader);
+}
+
+function DecodeBinarySchemaElement(reader: NetworkBufferReader) : ADataJSON | null {
+	const type : BinaryElementType = reader.extractUint8();
+	const length = reader.extractVarUint();
+	const payload = new NetworkBufferReader(reader.extractData(length));
+
+	const flags = payload.extractUint8();
+	const id = payload.extractVarUint();
+	const name = payload.extractVarString();
+
+	const base : ADataJSON = {
+		type: '',
+		name: name,
+		id: id === BINARY_INVALID_ELEMENT_ID ? undefined : id,
+		advanced: (flags & BINARY_FLAG_ADVANCED) !== 0,
+		readOnly: (flags & BINARY_FLAG_READ_ONLY) !== 0,
+	};
+
+	switch (type) {
+		case BinaryElementType.Root:
+		case BinaryElementType.Group: {
+			const elements : ADataJSON[] = [];
+
+			while (payload.getRemainingSize() > 0) {
+				const child = DecodeBinarySchemaElement(payload);
+
+				if (child) {
+					elements.push(child);
+				}
+			}
+
+			const collapsable = (flags & BINARY_FLAG_COLLAPSABLE) !== 0;
+
+			const group : GroupDataJSON = {...base,
+				type: type === BinaryElementType.Root ? 'root' : 'group',
+				elements: elements,
+				collapsed: collapsable ? (flags & BINARY_FLAG_COLLAPSED) !== 0 : undefined,
+			};
+
+			return group;
+		}
+
+		case BinaryElementType.Range: {
+			const range : RangeDataJSON = {...base, type: 'range', min: 0, max: 0, value: 0};
+			range.min = payload.extractInt32();
+			range.max = payload.extractInt32();
+			range.value = payload.extractInt32();
+			return range;
+		}
+
+		case BinaryElementType.Checkbox: {
+			const checkbox : CheckboxJSON = {...base, type: 'checkbox', value: payload.extractUint8()};
+			return checkbox;
+		}
+
+		case BinaryElementType.Radio:
+		case BinaryElementType.DropDown: {
+			const itemCount = payload.extractVarUint();
+			const items : string[] = [];
+
+			for (let i = 0; i < itemCount; ++i) {
+				items.push(payload.extractVarString());
+			}
+
+			const selector : RadioDataJSON = {...base,
+				type: type === BinaryElementType.Radio ? 'radio' : 'dropdown',
+				items: items,
+				value: payload.extractVarUint(),
+			};
+
+			return selector;
+		}
+
+		case BinaryElementType.Button: {
+			return {...base, type: 'button'};
+		}
+
+		case BinaryElementType.NumberFieldInt32: {
+			const numberField : NumberFieldJSON = {...base, type: 'numberfield_int32', value: payload.extractInt32()};
+			return numberField;
+		}
+
+		case BinaryElementType.TextField:
+		case BinaryElementType.PasswordField: {
+			const textField : TextFieldJSON = {...base,
+				type: type === BinaryElementType.TextField ? 'textfield' : 'password',
+				maxLength: 0,
+				value: '',
+			};
+
+			textField.maxLength = payload.extractVarUint();
+			textField.value = payload.extractVarString();
+			return textField;
+		}
+
+		case BinaryElementType.RGBWRange: {
+			const rgbwField : RGBWRangeFieldJSON = {...base, type: 'RGBWRange', channel: '', value: 0};
+			rgbwField.channel = payload.extractVarString();
+			rgbwField.value = payload.extractUint32();
+			return rgbwField;
+		}
+
+		case BinaryElementType.Compass: {
+			const compass : CompassFieldJSON = {...base, type: 'Compass', value: payload.extractFloat32()};
+			return compass;
+		}
+
+		default:
+			Log("Skipping unknown binary GUI element type: " + type);
+			return null;
+	}
+}
@@ -9,6 +9,12 @@ class PacketBuilder {
 		return data;
 	}
 
+	static CreateUInt16(number: number) : Uint8Array {
+		const data = new Uint8Array(2);
+		new DataView(data.buffer).setUint16(0, number, false);
+		return data;
+	}
+
 	static CreateUInt32(number: number) : Uint8Array {
 		const data = new Uint8Array(4);
 		new DataView(data.buffer).setUint32(0, number, false);
@@ -0,0 +1,389 @@
+// Time without a benchmark reply before a stream is finished with the data received so far
+const BENCHMARK_IDLE_TIMEOUT_MS = 3000;
+
+// Time to wait for the echo of a ping before it is counted as lost
+const BENCHMARK_PING_TIMEOUT_MS = 2000;
+
+/**
+ * Result of one benchmark measurement.
+ */
+class BenchmarkResult {
+	type: GUIBenchmarkType;
+	// Pings send, bytes or updates requested (as reported by the device)
+	expected: number;
+	// Pings, bytes or updates received
+	received: number;
+	// Pings without echo, bytes of missing or damaged segments, missing updates
+	lost: number;
+	// Bytes of the stream data (StreamBytes) or of the whole update packets (StreamUpdates) received after the first reply
+	sustainedBytes: number;
+	// Time from the first to the last reply of a stream
+	durationMs: number;
+	// Round trip times of the echoed pings, sorted
+	roundTripTimesMs: number[];
+
+	constructor(type: GUIBenchmarkType, expected: number) {
+		this.type = type;
+		this.expected = expected;
+		this.received = 0;
+		this.lost = 0;
+		this.sustainedBytes = 0;
+		this.durationMs = 0;
+		this.roundTripTimesMs = [];
+	}
+
+	/**
+	 * \returns the lost share of the expected pings, bytes or updates (0 - 1).
+	 */
+	getLossRatio() : number {
+		return (this.expected > 0) ? this.lost / this.expected : 0;
+	}
+
+	/**
+	 * \returns the bytes per second between the first and the last reply of a stream, 0 when unknown.
+	 */
+	getThroughput() : number {
+		return (this.durationMs > 0) ? this.sustainedBytes * 1000 / this.durationMs : 0;
+	}
+
+	/**
+	 * \returns the updates per second between the first and the last update, 0 when unknown.
+	 */
+	getUpdateRate() : number {
+		return (this.durationMs > 0 && this.received > 1) ? (this.received - 1) * 1000 / this.durationMs : 0;
+	}
+
+	/**
+	 * \returns the round trip time of the percentile (0 - 100, nearest rank), undefined without echoed pings.
+	 */
+	getRoundTripTimePercentile(percentile: number) : number | undefined {
+		const times = this.roundTripTimesMs;
+
+		if (times.length === 0) {
+			return undefined;
+		}
+
+		const rank = Math.ceil(percentile / 100 * times.length);
+		return times[Math.min(Math.max(rank, 1), times.length) - 1];
+	}
+}
+
+/**
+ * Runs the benchmarks of the device (see GUIClientHeader.Benchmark), one measurement at a time.
+ *
+ * The replies take the same way through the send queue of the device as the GUI downloads (StreamBytes),
+ * periodic values (StreamUpdates) and value echoes (Ping), so the numbers match what the GUI gets on this link.
+ */
+class GUIBenchmark {
+	// Sends the benchmark request with the parameters, returns the request id
+	sendRequestFunction: (type: GUIBenchmarkType, parameters: Uint8Array) => number;
+
+	// Only the replies of the running measurement are accepted
+	requestId: number | undefined;
+	result: BenchmarkResult | undefined;
+	onCompleteFunction: ((result: BenchmarkResult) => void) | undefined;
+	timer: number | undefined;
+
+	// Ping state: payload size, sequence number and send time of the pending ping
+	pingCount: number;
+	pingPayloadSize: number;
+	pingSequence: number;
+	pingSendTime: number;
+
+	// Stream state: next expected offset (StreamBytes) or received sequence numbers (StreamUpdates)
+	nextOffset: number;
+	receivedSequences: Set<number>;
+	idleTimeoutMs: number;
+	firstArrival: number | undefined;
+
+	constructor(sendRequestFunction: (type: GUIBenchmarkType, parameters: Uint8Array) => number) {
+		this.sendRequestFunction = sendRequestFunction;
+		this.requestId = undefined;
+		this.result = undefined;
+		this.onCompleteFunction = undefined;
+		this.timer = undefined;
+		this.pingCount = 0;
+		this.pingPayloadSize = 0;
+		this.pingSequence = 0;
+		this.pingSendTime = 0;
+		this.nextOffset = 0;
+		this.receivedSequences = new Set();
+		this.idleTimeoutMs = BENCHMARK_IDLE_TIMEOUT_MS;
+		this.firstArrival = undefined;
+	}
+
+	isRunning() : boolean {
+		return this.result !== undefined;
+	}
+
+	/**
+	 * Sends the pings one after another, each with a payload of the size (at least the 4 byte sequence number).
+	 */
+	runPings(count: number, payloadSize: number, onComplete: (result: BenchmarkResult) => void) {
+		this._start(new BenchmarkResult(GUIBenchmarkType.Ping, count), onComplete);
+
+		this.pingCount = count;
+		this.pingPayloadSize = Math.max(payloadSize, 4);
+		this.pingSequence = 0;
+
+		this._sendPing();
+	}
+
+	/**
+	 * Requests a stream of the length in bytes, the device sends it like a GUI download.
+	 */
+	runByteStream(length: number, onComplete: (result: BenchmarkResult) => void) {
+		this._start(new BenchmarkResult(GUIBenchmarkType.StreamBytes, length), onComplete);
+
+		this.nextOffset = 0;
+		this.idleTimeoutMs = BENCHMARK_IDLE_TIMEOUT_MS;
+		this.requestId = this.sendRequestFunction(GUIBenchmarkType.StreamBytes, PacketBuilder.CreateUInt32(length));
+		this._restartTimer(this.idleTimeoutMs);
+	}
+
+	/**
+	 * Requests the update packets (content size in bytes, 0 ms interval for as fast as possible),
+	 * the device sends them like periodic values.
+	 */
+	runUpdateStream(count: number, contentSize: number, intervalMs: number, onComplete: (result: BenchmarkResult) => void) {
+		this._start(new BenchmarkResult(GUIBenchmarkType.StreamUpdates, count), onComplete);
+
+		this.receivedSequences.clear();
+		this.idleTimeoutMs = BENCHMARK_IDLE_TIMEOUT_MS + intervalMs;
+
+		const parameters = MergeUint8Arrays3(PacketBuilder.CreateUInt32(count), PacketBuilder.CreateUInt16(contentSize), PacketBuilder.CreateUInt16(intervalMs));
+		this.requestId = this.sendRequestFunction(GUIBenchmarkType.StreamUpdates, parameters);
+		this._restartTimer(this.idleTimeoutMs);
+	}
+
+	/**
+	 * Stops the running measurement, later replies are ignored and the completion callback is not called.
+	 */
+	cancel() {
+		this.requestId = undefined;
+		this.result = undefined;
+		this.onCompleteFunction = undefined;
+
+		if (this.timer !== undefined) {
+			window.clearTimeout(this.timer);
+			this.timer = undefined;
+		}
+	}
+
+	/**
+	 * \returns false when the BenchmarkData packet does not belong to the running measurement.
+	 */
+	handleData(requestId: number, reader: NetworkBufferReader) : boolean {
+		const now = performance.now();
+
+		if (this.requestId === undefined || requestId !== this.requestId || this.result === undefined) {
+			return false;
+		}
+
+		if (reader.extractUint8() !== this.result.type) {
+			return false;
+		}
+
+		switch (this.result.type) {
+			case GUIBenchmarkType.Ping: {
+				this._handlePing(reader, now);
+				break;
+			}
+			case GUIBenchmarkType.StreamBytes: {
+				this._handleStreamSegment(reader, now);
+				break;
+			}
+			case GUIBenchmarkType.StreamUpdates: {
+				this._handleUpdate(reader, now);
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	private _start(result: BenchmarkResult, onComplete: (result: BenchmarkResult) => void) {
+		this.cancel();
+
+		this.result = result;
+		this.onCompleteFunction = onComplete;
+		this.firstArrival = undefined;
+	}
+
+	private _finish() {
+		const result = this.result;
+		const onComplete = this.onCompleteFunction;
+
+		this.cancel();
+
+		if (result && onComplete) {
+			onComplete(result);
+		}
+	}
+
+	private _restartTimer(timeoutMs: number) {
+		if (this.timer !== undefined) {
+			window.clearTimeout(this.timer);
+		}
+
+		this.timer = window.setTimeout(() => {
+			this.timer = undefined;
+			this._onTimeout();
+		}, timeoutMs);
+	}
+
+	private _onTimeout() {
+		if (!this.result) {
+			return;
+		}
+
+		switch (this.result.type) {
+			case GUIBenchmarkType.Ping: {
+				// No echo, continue with the next ping
+				this.result.lost++;
+				this.pingSequence++;
+				this._sendPing();
+				break;
+			}
+			case GUIBenchmarkType.StreamBytes: {
+				// The missing rest of the stream
+				this.result.lost += Math.max(this.result.expected - this.nextOffset, 0);
+				this._finish();
+				break;
+			}
+			case GUIBenchmarkType.StreamUpdates: {
+				this.result.lost = this.result.expected - this.result.received;
+				this._finish();
+				break;
+			}
+		}
+	}
+
+	private _sendPing() {
+		if (this.pingSequence >= this.pingCount) {
+			this._finish();
+			return;
+		}
+
+		const payload = new Uint8Array(this.pingPayloadSize);
+		new DataView(payload.buffer).setUint32(0, this.pingSequence, false);
+
+		this.requestId = this.sendRequestFunction(GUIBenchmarkType.Ping, payload);
+		this.pingSendTime = performance.now();
+		this._restartTimer(BENCHMARK_PING_TIMEOUT_MS);
+	}
+
+	private _handlePing(reader: NetworkBufferReader, now: number) {
+		if (!this.result || reader.getRemainingSize() < 4 || reader.extractUint32() !== this.pingSequence) {
+			// Echo of a ping which already timed out
+			return;
+		}
+
+		this.result.received++;
+		this.result.roundTripTimesMs.push(now - this.pingSendTime);
+		this.result.roundTripTimesMs.sort((a, b) => a - b);
+
+		this.pingSequence++;
+		this._sendPing();
+	}
+
+	/**
+	 * Segment of a byte stream: offset, total length and the pattern (uint8_t(offset)).
+	 */
+	private _handleStreamSegment(reader: NetworkBufferReader, now: number) {
+		const result = this.result;
+
+		if (!result || reader.getRemainingSize() < 8) {
+			return;
+		}
+
+		const offset = reader.extractUint32();
+		const totalLength = reader.extractUint32();
+		const data = new Uint8Array(reader.extractRemainingData().buffer);
+
+		// The device limits the length
+		result.expected = totalLength;
+
+		if (offset < this.nextOffset) {
+			return;
+		}
+
+		// Segments in between were missed
+		result.lost += offset - this.nextOffset;
+
+		let damaged = false;
+
+		for (let i = 0; i < data.length && !damaged; ++i) {
+			damaged = data[i] !== ((offset + i) & 0xFF);
+		}
+
+		if (damaged) {
+			result.lost += data.length;
+		} else {
+			result.received += data.length;
+		}
+
+		this._onStreamArrival(data.length, now);
+
+		this.nextOffset = offset + data.length;
+
+		if (this.nextOffset >= totalLength) {
+			this._finish();
+			return;
+		}
+
+		this._restartTimer(this.idleTimeoutMs);
+	}
+
+	/**
+	 * Update packet: sequence number, count, device time and padding.
+	 */
+	private _handleUpdate(reader: NetworkBufferReader, now: number) {
+		const result = this.result;
+
+		if (!result || reader.getRemainingSize() < 12) {
+			return;
+		}
+
+		// The whole packet (header, benchmark type and content) counts, like a value update
+		const packetSize = PACKET_HEADER_SIZE + 1 + reader.getRemainingSize();
+
+		const sequence = reader.extractUint32();
+		const count = reader.extractUint32();
+
+		// The device limits the count
+		result.expected = count;
+
+		if (this.receivedSequences.has(sequence)) {
+			return;
+		}
+
+		this.receivedSequences.add(sequence);
+		result.received++;
+
+		this._onStreamArrival(packetSize, now);
+
+		if (sequence + 1 >= count) {
+			result.lost = result.expected - result.received;
+			this._finish();
+			return;
+		}
+
+		this._restartTimer(this.idleTimeoutMs);
+	}
+
+	private _onStreamArrival(size: number, now: number) {
+		if (!this.result) {
+			return;
+		}
+
+		if (this.firstArrival === undefined) {
+			// The first reply includes the request latency, the throughput is measured from here
+			this.firstArrival = now;
+			return;
+		}
+
+		this.result.sustainedBytes += size;
+		this.result.durationMs = now - this.firstArrival;
+	}
+}
@@ -1,32 +1,142 @@
 enum GUIClientHeader {
 	RequestGUI = 0x00,
 	SetValue = 0x01,
+	SetValueById = 0x02,
+	RequestGUIBinary = 0x03,
+	RequestGUIHash = 0x04,
+	RequestGUIValues = 0x05,
+	SetValues = 0x06,
+	RequestTransfer = 0x07,
+	SetSubtreeVisible = 0x08,
+	RequestGUISubtree = 0x09,
+	Benchmark = 0x0A,
 }
 
 enum GUIServerHeader {
 	GUIData = 0x00,
 	UpdateValue = 0x01,
 	UpdateFlag = 0x02,
+	UpdateValueById = 0x03,
+	UpdateFlagById = 0x04,
+	GUIDataBinary = 0x05,
+	GUIHash = 0x06,
+	GUIValues = 0x07,
+	UpdateValues = 0x08,
+	UpdateValuesById = 0x09,
+	StreamChunk = 0x0A,
+	TransferSegment = 0x0B,
+	UpdateValuesCompact = 0x0C,
+	GUISubtree = 0x0D,
+	BenchmarkData = 0x0E,
 }
 
+enum GUIBenchmarkType {
+	Ping = 0x00,
+	StreamBytes = 0x01,
+	StreamUpdates = 0x02,
+}
+
+// Size of the header in front of every device packet (head byte, request id, content length)
+const PACKET_HEADER_SIZE = 9;
+
+// Flag on the value type of a compact value record: Int32 as zig-zag delta against the last compact value of the element
+const COMPACT_VALUE_DELTA = 0x80;
+
+// Capability flag in the GUIHash reply: RequestTransfer is supported
+const GUI_CAPABILITY_RELIABLE_TRANSFER = 0x01;
+
+// Capability flag in the GUIHash reply: RequestGUISubtree is supported
+const GUI_CAPABILITY_SUBTREES = 0x02;
+
+// Capability flag in the GUIHash reply: Benchmark requests are supported
+const GUI_CAPABILITY_BENCHMARK = 0x04;
+
+// Group levels loaded by one subtree request, deeper groups are placeholders loaded when they are shown
+const GUI_SUBTREE_REQUEST_DEPTH = 1;
+
+// Time to wait for the binary GUI description before falling back to JSON (older firmware)
+const GUI_BINARY_REQUEST_TIMEOUT_MS = 3000;
+
+// Time to wait for the structure hash before requesting the JSON GUI description (older firmware)
+const GUI_HASH_REQUEST_TIMEOUT_MS = 3000;
+
 class GUIProtocolHandler {
 	characteristic: BluetoothRemoteGATTCharacteristic;
 	onGuiJsonCallback: (json: ADataJSON) => void;
+	onSubtreeJsonCallback: (path: string[], json: GroupDataJSON) => void;
 	onValueUpdateCallback: (path: string[], newValue: ValueWrapper) => void;
 	onFlagUpdateCallback: (path: string[], flag: UIFlagType, newState: boolean) => void;
 	dataWriter: BLEDataWriter;
 	onCharacteristicChanged: (event: Event) => void;
 	recvPendingData : BLEDataReader | undefined;
+	// Pending packets of interleaved streams (StreamChunk), by stream id
+	recvPendingStreams: Map<number, BLEDataReader>;
+	// Update packets received while loading the GUI, applied after the GUI description / values
+	heldBackUpdates: Uint8Array[] | undefined;
 	pendingRequestIds: Set<number>;
-
-	constructor(characteristic: BluetoothRemoteGATTCharacteristic, onGuiJsonCallback: (json: ADataJSON) => void, onValueUpdateCallback: (path: string[], newValue: ValueWrapper) => void, onFlagUpdateCallback: (path: string[], flag: UIFlagType, newState: boolean) => void) {
+	nextRequestId: number;
+	// Numeric element ids from the GUI description, mapped by the path (comma separated) and in reverse
+	elementIds: Map<string, number>;
+	elementPaths: Map<number, string[]>;
+	guiRequestFallbackTimer: number | undefined;
+	// Key of the device for the GUI description cache
+	cacheKey: string;
+	// Structure hash of the GUI description currently requested / displayed
+	schemaHash: number | undefined;
+	// The device supports reliable transfers, the GUI description and values are loaded by TransferSegment packets
+	reliableTransfer: boolean;
+	activeTransfers: Set<TransferReceiver>;
+	// Last Int32 value of the elements from UpdateValuesCompact packets, the base of the following deltas
+	compactValueBases: Map<number, number>;
+	// Subtrees (paths, comma separated) reported as hidden, the device does not send their value updates
+	hiddenSubtrees: Set<string>;
+	// The device supports subtree requests, the GUI description is loaded group by group when the groups are shown
+	lazySubtrees: boolean;
+	// GUI description loaded by subtree requests, the placeholder groups are replaced by the loaded subtrees
+	lazyDescription: ADataJSON | undefined;
+	// Placeholder groups of the lazyDescription by path (comma separated)
+	placeholders: Map<string, GroupDataJSON>;
+	// Path of the subtree by request id
+	pendingSubtreeRequests: Map<number, string[]>;
+	// Placeholders which were shown, the device is told once they are loaded
+	deferredVisibleSubtrees: Set<string>;
+	// The device supports benchmark requests
+	benchmarkSupported: boolean;
+	benchmark: GUIBenchmark;
+
+	constructor(characteristic: BluetoothRemoteGATTCharacteristic, cacheKey: string, onGuiJsonCallback: (json: ADataJSON) => void, onSubtreeJsonCallback: (path: string[], json: GroupDataJSON) => void, onValueUpdateCallback: (path: string[], newValue: ValueWrapper) => void, onFlagUpdateCallback: (path: string[], flag: UIFlagType, newState: boolean) => void) {
 		this.characteristic = characteristic;
+		this.cacheKey = cacheKey;
 		this.onGuiJsonCallback = onGuiJsonCallback;
+		this.onSubtreeJsonCallback = onSubtreeJsonCallback;
 		this.onValueUpdateCallback = onValueUpdateCallback;
 		this.onFlagUpdateCallback = onFlagUpdateCallback;
 		this.dataWriter = new BLEDataWriter(characteristic);
 		this.onCharacteristicChanged = (event: Event) => {this._onCharacteristicChanged(event);};
 		this.pendingRequestIds = new Set();
+		// Random start, the replies to other clients (e.g. other tabs) don't match the own requests
+		this.nextRequestId = Math.floor(Math.random() * 0xFFFFFFFF);
+		this.recvPendingStreams = new Map();
+		this.elementIds = new Map();
+		this.elementPaths = new Map();
+		this.reliableTransfer = false;
+		this.activeTransfers = new Set();
+		this.compactValueBases = new Map();
+		this.hiddenSubtrees = new Set();
+		this.lazySubtrees = false;
+		this.lazyDescription = undefined;
+		this.placeholders = new Map();
+		this.pendingSubtreeRequests = new Map();
+		this.deferredVisibleSubtrees = new Set();
+		this.benchmarkSupported = false;
+		this.benchmark = new GUIBenchmark((type: GUIBenchmarkType, parameters: Uint8Array) => {
+			const requestId = this._generateRequestId();
+			const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.Benchmark, requestId);
+			const packet = MergeUint8Arrays3(head, PacketBuilder.CreateUInt8(type), parameters);
+
+			this.dataWriter.sendData('Benchmark-' + requestId, packet);
+			return requestId;
+		});
 
 		characteristic.addEventListener('characteristicvaluechanged', this.onCharacteristicChanged);
 
@@ -47,29 +157,217 @@ class GUIProtocolHandler {
 
 	setValue(absoluteName: string[], newValue: ValueWrapper) {
 		const requestId = this._generateRequestId();
-
-		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.SetValue, requestId);
-		const name = PacketBuilder.CreateLengthPrefixedString(absoluteName.toString());
+		const elementId = this.elementIds.get(absoluteName.toString());
 		const value = PacketBuilder.CreateDynamicValue(newValue);
 
-		const packet = MergeUint8Arrays3(head, name, value);
+		let packet : Uint8Array;
+
+		if (elementId !== undefined) {
+			const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.SetValueById, requestId);
+			packet = MergeUint8Arrays3(head, PacketBuilder.CreateUInt16(elementId), value);
+		} else {
+			const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.SetValue, requestId);
+			const name = PacketBuilder.CreateLengthPrefixedString(absoluteName.toString());
+			packet = MergeUint8Arrays3(head, name, value);
+		}
 
 		this.dataWriter.sendData(absoluteName.toString(), packet);
 	}
 
+	/**
+	 * Reports a collapsed / hidden subtree to the device, it only sends value updates for the visible elements.
+	 * The device sends the current values again when the subtree is shown.
+	 * A shown placeholder group is loaded first, the device is told afterwards.
+	 */
+	setSubtreeVisible(absoluteName: string[], visible: boolean) {
+		const path = absoluteName.toString();
+
+		if (visible && this.placeholders.has(path)) {
+			this.deferredVisibleSubtrees.add(path);
+			this._requestGUISubtree(absoluteName);
+			return;
+		}
+
+		if (!visible && this.deferredVisibleSubtrees.delete(path))
+			return;
+
+		if (absoluteName.length === 0 || this.hiddenSubtrees.has(path) !== visible)
+			return;
+
+		if (visible) {
+			// The device sends the values of hidden elements as absolute values, the delta bases stay valid
+			this.hiddenSubtrees.delete(path);
+		} else {
+			this.hiddenSubtrees.add(path);
+		}
+
+		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.SetSubtreeVisible, this._generateRequestId());
+		const packet = MergeUint8Arrays3(head, PacketBuilder.CreateUInt8(visible ? 1 : 0), PacketBuilder.CreateLengthPrefixedString(path));
+
+		this.dataWriter.sendData('visible-' + path, packet);
+
+		if (visible) {
+			this._requestVisiblePlaceholders();
+		}
+	}
+
+	/**
+	 * Sends several values as one transaction, the device applies all of them at once.
+	 * \returns false when an element id is unknown (older firmware), the values must be send one by one then.
+	 */
+	setValues(values: [string[], ValueWrapper][]) : boolean {
+		const records : Uint8Array[] = [];
+
+		for (const [absoluteName, newValue] of values) {
+			const elementId = this.elementIds.get(absoluteName.toString());
+
+			if (elementId === undefined) {
+				return false;
+			}
+
+			records.push(MergeUint8Arrays(PacketBuilder.CreateUInt16(elementId), PacketBuilder.CreateDynamicValue(newValue)));
+		}
+
+		const requestId = this._generateRequestId();
+		let packet : Uint8Array = PacketBuilder.CreatePacketHeader(GUIClientHeader.SetValues, requestId);
+
+		records.forEach(record => {packet = MergeUint8Arrays(packet, record);});
+
+		// Unique group, a transaction must not replace another one. Long write, the packet may exceed the MTU.
+		this.dataWriter.sendData('values-' + requestId, packet, true);
+		return true;
+	}
+
 	private _generateRequestId() : number {
-		// TODO: Better unique request id (random number)
-		const requestId = Date.now() % 0xFFFFFFFF;
+		// Unique per handler, even for requests sent in the same millisecond. 0xFFFFFFFF is the broadcast id of the device.
+		const requestId = this.nextRequestId;
+		this.nextRequestId = (this.nextRequestId + 1) % 0xFFFFFFFF;
 		this.pendingRequestIds.add(requestId);
 		return requestId;
 	}
 
 	private _requestGUI() {
+		// Updates may overtake the (lower priority) GUI download, apply them afterwards
+		this.heldBackUpdates = [];
+
+		// Ask for the structure hash first, a cached GUI description only needs the current values
+		const requestId = this._generateRequestId();
+		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestGUIHash, requestId);
+		this.dataWriter.sendData('RequestHeader', head);
+
+		this.guiRequestFallbackTimer = window.setTimeout(() => {
+			// Devices without the hash request predate the binary description as well, don't wait for that one too
+			Log("No GUI structure hash received, requesting JSON ...");
+			this._requestGUIJson();
+		}, GUI_HASH_REQUEST_TIMEOUT_MS);
+	}
+
+	/**
+	 * Requests the subtree of the path (empty for the whole GUI), the child groups are placeholders.
+	 */
+	private _requestGUISubtree(absoluteName: string[]) {
+		for (const pendingPath of this.pendingSubtreeRequests.values()) {
+			if (pendingPath.toString() === absoluteName.toString())
+				return;
+		}
+
+		const requestId = this._generateRequestId();
+		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestGUISubtree, requestId);
+		const packet = MergeUint8Arrays3(head, PacketBuilder.CreateUInt8(GUI_SUBTREE_REQUEST_DEPTH), PacketBuilder.CreateLengthPrefixedString(absoluteName.toString()));
+
+		this.pendingSubtreeRequests.set(requestId, absoluteName);
+		this.dataWriter.sendData('RequestSubtree-' + absoluteName.toString(), packet);
+	}
+
+	/**
+	 * Requests the placeholders which are not inside a hidden subtree (collapsed group, hidden advanced field).
+	 */
+	private _requestVisiblePlaceholders() {
+		for (const path of this.placeholders.keys()) {
+			const absoluteName = path.split(',');
+			let hidden = false;
+
+			for (let i = 1; i <= absoluteName.length && !hidden; ++i) {
+				hidden = this.hiddenSubtrees.has(absoluteName.slice(0, i).toString());
+			}
+
+			if (!hidden) {
+				this._requestGUISubtree(absoluteName);
+			}
+		}
+	}
+
+	private _requestGUIDescription() {
+		if (this.reliableTransfer) {
+			this._startTransfer(GUIClientHeader.RequestGUIBinary, (data: Uint8Array) => {
+				const object = DecodeBinarySchema(new DataView(data.buffer));
+
+				if (object) {
+					this._onGUIDescriptionReceived(object);
+				}
+			}, () => {
+				this.reliableTransfer = false;
+				this._requestGUIDescription();
+			});
+			return;
+		}
+
+		// Prefer the compact binary description, older devices do not answer this request
+		const requestId = this._generateRequestId();
+		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestGUIBinary, requestId);
+		this.dataWriter.sendData('RequestHeader', head);
+
+		this.guiRequestFallbackTimer = window.setTimeout(() => {
+			Log("No binary GUI description received, requesting JSON ...");
+			this._requestGUIJson();
+		}, GUI_BINARY_REQUEST_TIMEOUT_MS);
+	}
+
+	private _requestGUIJson() {
 		const requestId = this._generateRequestId();
 		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestGUI, requestId);
 		this.dataWriter.sendData('RequestHeader', head);
 	}
 
+	private _requestGUIValues() {
+		if (this.reliableTransfer) {
+			this._startTransfer(GUIClientHeader.RequestGUIValues, (data: Uint8Array) => {
+				this._applyGUIValues(new NetworkBufferReader(new DataView(data.buffer)));
+			}, () => {
+				this.reliableTransfer = false;
+				this._requestGUIValues();
+			});
+			return;
+		}
+
+		const requestId = this._generateRequestId();
+		const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestGUIValues, requestId);
+		this.dataWriter.sendData('RequestHeader', head);
+	}
+
+	/**
+	 * Loads the data of the request type by a reliable transfer, the segments are handled by the receiver until it is complete.
+	 */
+	private _startTransfer(requestType: GUIClientHeader, onComplete: (data: Uint8Array) => void, onFail: () => void) {
+		const transfer : TransferReceiver = new TransferReceiver(requestType, (type: GUIClientHeader, offset: number) => {
+			const requestId = this._generateRequestId();
+			const head = PacketBuilder.CreatePacketHeader(GUIClientHeader.RequestTransfer, requestId);
+			const packet = MergeUint8Arrays3(head, PacketBuilder.CreateUInt8(type), PacketBuilder.CreateUInt32(offset));
+
+			this.dataWriter.sendData('RequestTransfer-' + type, packet);
+			return requestId;
+		}, (data: Uint8Array) => {
+			this.activeTransfers.delete(transfer);
+			onComplete(data);
+		}, () => {
+			this.activeTransfers.delete(transfer);
+			onFail();
+		});
+
+		this.activeTransfers.add(transfer);
+		transfer.start();
+	}
+
 	private _onCharacteristicChanged(event: Event) {
 		const value = <DataView> this.characteristic.value;
 		const view = new Uint8Array(value.buffer);
@@ -84,23 +382,136 @@ class GUIProtocolHandler {
 			return;
 		}
 
-		this._handlePacketBegin(view);
+		if (view[0] === GUIServerHeader.StreamChunk) {
+			this._handleStreamChunk(view);
+			return;
+		}
+
+		this._handlePacketBegin(view, undefined);
 	}
 
-	private _handlePacketBegin(data: Uint8Array) {
+	/**
+	 * Chunk of an interleaved packet: stream id followed by the packet data.
+	 * The packets of one stream are send one after another, the first chunk starts with the packet header.
+	 */
+	private _handleStreamChunk(data: Uint8Array) {
+		const streamId = data[1];
+		const packetData = data.slice(2);
+		const pendingData = this.recvPendingStreams.get(streamId);
+
+		if (pendingData) {
+			if (pendingData.appendData(packetData)) {
+				this.recvPendingStreams.delete(streamId);
+			}
+
+			return;
+		}
+
+		this._handlePacketBegin(packetData, streamId);
+	}
+
+	/**
+	 * Appends the first part of the packet content, the remaining chunks are appended to the reader of the stream.
+	 */
+	private _receivePacketContent(streamId: number | undefined, reader: BLEDataReader, content: Uint8Array) {
+		if (reader.appendData(content)) {
+			return;
+		}
+
+		if (streamId === undefined) {
+			this.recvPendingData = reader;
+		} else {
+			this.recvPendingStreams.set(streamId, reader);
+		}
+	}
+
+	private _releaseHeldBackUpdates() {
+		const packets = this.heldBackUpdates;
+		this.heldBackUpdates = undefined;
+
+		if (packets) {
+			packets.forEach(packet => this._handlePacketBegin(packet, undefined));
+		}
+	}
+
+	private static _isUpdatePacket(headByte: number) : boolean {
+		switch (headByte) {
+			case GUIServerHeader.UpdateValue:
+			case GUIServerHeader.UpdateFlag:
+			case GUIServerHeader.UpdateValueById:
+			case GUIServerHeader.UpdateFlagById:
+			case GUIServerHeader.UpdateValues:
+			case GUIServerHeader.UpdateValuesById:
+			case GUIServerHeader.UpdateValuesCompact:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	private _handlePacketBegin(data: Uint8Array, streamId: number | undefined) {
+		if (this.heldBackUpdates !== undefined && GUIProtocolHandler._isUpdatePacket(data[0])) {
+			this.heldBackUpdates.push(data);
+			return;
+		}
+
 		const content = new DataView(data.buffer.slice(1));
 
 		switch (data[0]) {
 			case GUIServerHeader.GUIData: {
-				this._handlePacket_GUIData(content)
+				this._handlePacket_GUIData(content, false, streamId);
+				break;
+			}
+			case GUIServerHeader.GUIDataBinary: {
+				this._handlePacket_GUIData(content, true, streamId);
+				break;
+			}
+			case GUIServerHeader.GUIHash: {
+				this._handlePacket_GUIHash(content);
+				break;
+			}
+			case GUIServerHeader.GUIValues: {
+				this._handlePacket_GUIValues(content, streamId);
 				break;
 			}
 			case GUIServerHeader.UpdateValue: {
-				this._handlePacket_UpdateValue(content);
+				this._handlePacket_UpdateValue(content, false);
 				break;
 			}
 			case GUIServerHeader.UpdateFlag: {
-				this._handlePacket_UpdateFlag(content);
+				this._handlePacket_UpdateFlag(content, false);
+				break;
+			}
+			case GUIServerHeader.UpdateValueById: {
+				this._handlePacket_UpdateValue(content, true);
+				break;
+			}
+			case GUIServerHeader.UpdateValues: {
+				this._handlePacket_UpdateValues(content, false);
+				break;
+			}
+			case GUIServerHeader.UpdateValuesById: {
+				this._handlePacket_UpdateValues(content, true);
+				break;
+			}
+			case GUIServerHeader.UpdateFlagById: {
+				this._handlePacket_UpdateFlag(content, true);
+				break;
+			}
+			case GUIServerHeader.TransferSegment: {
+				this._handlePacket_TransferSegment(content);
+				break;
+			}
+			case GUIServerHeader.UpdateValuesCompact: {
+				this._handlePacket_UpdateValuesCompact(content);
+				break;
+			}
+			case GUIServerHeader.GUISubtree: {
+				this._handlePacket_GUISubtree(content, streamId);
+				break;
+			}
+			case GUIServerHeader.BenchmarkData: {
+				this._handlePacket_BenchmarkData(content, streamId);
 				break;
 			}
 			default:
@@ -108,7 +519,7 @@ class GUIProtocolHandler {
 		}
 	}
 
-	private _handlePacket_GUIData(content: DataView) {
+	private _handlePacket_GUIData(content: DataView, binary: boolean, streamId: number | undefined) {
 		const reader : NetworkBufferReader = new NetworkBufferReader(content);
 
 		const requestId = reader.extractUint32();
@@ -116,30 +527,256 @@ class GUIProtocolHandler {
 
 		const isOwnRequest : boolean = this.pendingRequestIds.has(requestId);
 
-		Log("JSON data length: " + length + " bytes, is own request: " + isOwnRequest);
+		Log((binary ? "Binary" : "JSON") + " data length: " + length + " bytes, is own request: " + isOwnRequest);
+
+		if (isOwnRequest && this.guiRequestFallbackTimer !== undefined) {
+			window.clearTimeout(this.guiRequestFallbackTimer);
+			this.guiRequestFallbackTimer = undefined;
+		}
 
 		const ref = this;
 
 		const remainingContent = new Uint8Array(reader.extractRemainingData().buffer);
 
-		this.recvPendingData = new BLEDataReader(length, function(wholeBlock: Uint8Array) {
-			const jsonString = DecodeUTF8String(wholeBlock);
-			const object = <ADataJSON>JSON.parse(jsonString);
+		this._receivePacketContent(streamId, new BLEDataReader(length, function(wholeBlock: Uint8Array) {
+			let object : ADataJSON | null;
 
-			if (isOwnRequest) {
+			if (binary) {
+				object = DecodeBinarySchema(new DataView(wholeBlock.buffer));
+			} else {
+				object = <ADataJSON>JSON.parse(DecodeUTF8String(wholeBlock));
+			}
+
+			if (isOwnRequest && object) {
 				ref.pendingRequestIds.delete(requestId);
-				ref.onGuiJsonCallback(object);
+				ref._onGUIDescriptionReceived(object);
 			}
-		});
+		}), remainingContent);
+	}
+
+	private _onGUIDescriptionReceived(object: ADataJSON) {
+		this._indexElementIds(object);
+		this.onGuiJsonCallback(object);
+		this._releaseHeldBackUpdates();
+
+		if (this.schemaHash !== undefined) {
+			StoreCachedGUISchema(this.cacheKey, this.schemaHash, object);
+		}
+	}
 
-		let completed = this.recvPendingData.appendData(remainingContent);
+	private _handlePacket_GUISubtree(content: DataView, streamId: number | undefined) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+
+		const path = this.pendingSubtreeRequests.get(requestId);
+
+		const ref = this;
+
+		const remainingContent = new Uint8Array(reader.extractRemainingData().buffer);
+
+		this._receivePacketContent(streamId, new BLEDataReader(length, function(wholeBlock: Uint8Array) {
+			if (path === undefined) {
+				return;
+			}
+
+			ref.pendingRequestIds.delete(requestId);
+			ref.pendingSubtreeRequests.delete(requestId);
+
+			const blockReader = new NetworkBufferReader(new DataView(wholeBlock.buffer));
+			const hash = blockReader.extractUint32();
+
+			if (hash !== ref.schemaHash || blockReader.getRemainingSize() === 0) {
+				// The GUI was changed, the loaded parts do not fit to the subtree
+				Log("GUI structure hash changed, reloading GUI ...");
+				ref._requestGUI();
+				return;
+			}
+
+			const object = <GroupDataJSON>JSON.parse(DecodeUTF8String(new Uint8Array(blockReader.extractRemainingData().buffer)));
+			ref._onGUISubtreeReceived(path, object);
+		}), remainingContent);
+	}
+
+	private _onGUISubtreeReceived(path: string[], object: GroupDataJSON) {
+		if (path.length === 0) {
+			this.lazyDescription = object;
+			this.placeholders.clear();
+			this._indexElementIds(object);
+			this.onGuiJsonCallback(object);
+			this._releaseHeldBackUpdates();
+		} else {
+			const placeholder = this.placeholders.get(path.toString());
+
+			if (!placeholder) {
+				return;
+			}
+
+			if (object.name !== path[path.length - 1]) {
+				// Not the requested group, keep the placeholder, it is requested again when shown
+				Log("Received subtree " + object.name + " does not match " + path.toString() + ", ignoring");
+				return;
+			}
+
+			// Complete the description, it is cached once all placeholders are loaded
+			placeholder.elements = object.elements;
+			placeholder.lazy = undefined;
+			this.placeholders.delete(path.toString());
+
+			this._indexSubtreeElementIds(object, path.slice(0, -1));
+			this.onSubtreeJsonCallback(path, object);
+
+			if (this.deferredVisibleSubtrees.delete(path.toString())) {
+				this.setSubtreeVisible(path, true);
+			}
+		}
+
+		this._requestVisiblePlaceholders();
+
+		if (this.placeholders.size === 0 && this.lazyDescription !== undefined && this.schemaHash !== undefined) {
+			StoreCachedGUISchema(this.cacheKey, this.schemaHash, this.lazyDescription);
+			this.lazyDescription = undefined;
+		}
+	}
+
+	private _handlePacket_GUIHash(content: DataView) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+		const hash = reader.extractUint32();
+		// Older firmware sends the hash only
+		const capabilities = (reader.getRemainingSize() > 0) ? reader.extractUint8() : 0;
 
-		if (completed) {
-			this.recvPendingData = undefined;
+		if (!this.pendingRequestIds.has(requestId)) {
+			return;
+		}
+
+		this.reliableTransfer = (capabilities & GUI_CAPABILITY_RELIABLE_TRANSFER) !== 0;
+		this.lazySubtrees = (capabilities & GUI_CAPABILITY_SUBTREES) !== 0;
+		this.benchmarkSupported = (capabilities & GUI_CAPABILITY_BENCHMARK) !== 0;
+
+		this.pendingRequestIds.delete(requestId);
+
+		if (this.guiRequestFallbackTimer !== undefined) {
+			window.clearTimeout(this.guiRequestFallbackTimer);
+			this.guiRequestFallbackTimer = undefined;
+		}
+
+		this.schemaHash = hash;
+
+		const cachedSchema = LoadCachedGUISchema(this.cacheKey, hash);
+
+		if (!cachedSchema && this.lazySubtrees) {
+			Log("GUI structure hash " + hash.toString(16) + " not cached, loading GUI on demand ...");
+			this.placeholders.clear();
+			this.pendingSubtreeRequests.clear();
+			this.deferredVisibleSubtrees.clear();
+			this._requestGUISubtree([]);
+			return;
 		}
+
+		if (!cachedSchema) {
+			Log("GUI structure hash " + hash.toString(16) + " not cached, requesting GUI description ...");
+			this._requestGUIDescription();
+			return;
+		}
+
+		Log("Using cached GUI description with structure hash " + hash.toString(16));
+
+		this._indexElementIds(cachedSchema);
+		this.onGuiJsonCallback(cachedSchema);
+		this._requestGUIValues();
 	}
 
-	private _handlePacket_UpdateValue(content: DataView) {
+	private _handlePacket_GUIValues(content: DataView, streamId: number | undefined) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+
+		const isOwnRequest : boolean = this.pendingRequestIds.has(requestId);
+
+		const ref = this;
+
+		const remainingContent = new Uint8Array(reader.extractRemainingData().buffer);
+
+		this._receivePacketContent(streamId, new BLEDataReader(length, function(wholeBlock: Uint8Array) {
+			if (!isOwnRequest) {
+				return;
+			}
+
+			ref.pendingRequestIds.delete(requestId);
+			ref._applyGUIValues(new NetworkBufferReader(new DataView(wholeBlock.buffer)));
+		}), remainingContent);
+	}
+
+	private _handlePacket_TransferSegment(content: DataView) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+
+		// A segment always fits into one notification
+		if (reader.getRemainingSize() !== length || length < 12) {
+			Log("Invalid transfer segment, length: " + length);
+			return;
+		}
+
+		for (const transfer of this.activeTransfers) {
+			if (transfer.handleSegment(requestId, reader)) {
+				this.pendingRequestIds.delete(requestId);
+				return;
+			}
+		}
+	}
+
+	private _handlePacket_BenchmarkData(content: DataView, streamId: number | undefined) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+
+		const ref = this;
+
+		const remainingContent = new Uint8Array(reader.extractRemainingData().buffer);
+
+		// Larger pings and updates are split on links with a small MTU
+		this._receivePacketContent(streamId, new BLEDataReader(length, function(wholeBlock: Uint8Array) {
+			if (ref.benchmark.handleData(requestId, new NetworkBufferReader(new DataView(wholeBlock.buffer)))) {
+				ref.pendingRequestIds.delete(requestId);
+			}
+		}), remainingContent);
+	}
+
+	private _applyGUIValues(reader: NetworkBufferReader) {
+		const hash = reader.extractUint32();
+
+		if (hash !== this.schemaHash) {
+			// The GUI was changed after the hash was requested, the cached description is outdated
+			Log("GUI structure hash changed, requesting GUI description ...");
+			RemoveCachedGUISchema(this.cacheKey);
+			this.schemaHash = hash;
+			this._requestGUIDescription();
+			return;
+		}
+
+		while (reader.getRemainingSize() > 0) {
+			const path = this._readElementPath(reader, true);
+			const value : ValueWrapper = this._readDataValue(reader);
+
+			try {
+				this.onValueUpdateCallback(path, value);
+			} catch (err) {
+				Log("Error during GUIValues packet: " + err);
+			}
+		}
+
+		this._releaseHeldBackUpdates();
+	}
+
+	private _handlePacket_UpdateValue(content: DataView, byId: boolean) {
 		const reader : NetworkBufferReader = new NetworkBufferReader(content);
 
 		const requestId = reader.extractUint32();
@@ -153,17 +790,98 @@ class GUIProtocolHandler {
 		}
 
 		// Value update by another instance (or remote itself)
-		const key = reader.extractString();
+		const path = this._readElementPath(reader, byId);
 		const value : ValueWrapper = this._readDataValue(reader);
 
 		try {
-			this.onValueUpdateCallback(key.split(','), value);
+			this.onValueUpdateCallback(path, value);
 		} catch (err) {
 			Log("Error during UpdateValue packet: " + err);
 		}
 	}
 
-	private _handlePacket_UpdateFlag(content: DataView) {
+	/**
+	 * Batch of value updates, the records (element reference + value) fill the whole packet.
+	 */
+	private _handlePacket_UpdateValues(content: DataView, byId: boolean) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		const requestId = reader.extractUint32();
+		const length = reader.extractUint32();
+
+		if (this.pendingRequestIds.has(requestId)) {
+			return;
+		}
+
+		while (reader.getRemainingSize() > 0) {
+			try {
+				const path = this._readElementPath(reader, byId);
+				const value : ValueWrapper = this._readDataValue(reader);
+
+				this.onValueUpdateCallback(path, value);
+			} catch (err) {
+				Log("Error during UpdateValues packet: " + err);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * Compact value records until the end of the notification: LEB128 element id, value type and value.
+	 * Int32 values are zig-zag encoded, as delta against the last compact value of the element when flagged.
+	 */
+	private _handlePacket_UpdateValuesCompact(content: DataView) {
+		const reader : NetworkBufferReader = new NetworkBufferReader(content);
+
+		while (reader.getRemainingSize() > 0) {
+			try {
+				const elementId = reader.extractVarUint();
+				const valueType = reader.extractUint8();
+				let value : ValueWrapper;
+
+				switch (valueType & ~COMPACT_VALUE_DELTA) {
+					case ValueType.Int32: {
+						let numberValue : number = reader.extractZigZagInt();
+
+						if (valueType & COMPACT_VALUE_DELTA) {
+							const base = this.compactValueBases.get(elementId);
+
+							if (base === undefined) {
+								// Connected after the absolute value, wait for the next one
+								continue;
+							}
+
+							numberValue = (base + numberValue) | 0;
+						}
+
+						this.compactValueBases.set(elementId, numberValue);
+						value = new ValueWrapper(numberValue);
+						break;
+					}
+					case ValueType.String: {
+						const stringValue : string = reader.extractVarString();
+						value = new ValueWrapper(stringValue);
+						break;
+					}
+					default: {
+						// Same as the regular encoding
+						value = this._readTypedDataValue(reader, valueType);
+					}
+				}
+
+				const path = this.elementPaths.get(elementId);
+
+				if (path) {
+					this.onValueUpdateCallback(path, value);
+				}
+			} catch (err) {
+				Log("Error during UpdateValuesCompact packet: " + err);
+				return;
+			}
+		}
+	}
+
+	private _handlePacket_UpdateFlag(content: DataView, byId: boolean) {
 		const reader : NetworkBufferReader = new NetworkBufferReader(content);
 
 		const requestId = reader.extractUint32();
@@ -176,20 +894,69 @@ class GUIProtocolHandler {
 			return;
 		}
 
-		const key = reader.extractString();
+		const path = this._readElementPath(reader, byId);
 		const flag : UIFlagType = reader.extractUint8();
 		const newState : boolean = reader.extractUint8() > 0;
 
 		try {
-			this.onFlagUpdateCallback(key.split(','), flag, newState);
+			this.onFlagUpdateCallback(path, flag, newState);
 		} catch (err) {
 			Log("Error during UpdateFlag packet: " + err);
 		}
 	}
 
+	/**
+	 * Reads the element reference of a packet, either the numeric element id or the path string.
+	 */
+	private _readElementPath(reader : NetworkBufferReader, byId: boolean) : string[] {
+		if (!byId) {
+			return reader.extractString().split(',');
+		}
+
+		const elementId = reader.extractUint16();
+		const path = this.elementPaths.get(elementId);
+
+		if (path === undefined) {
+			throw "Received update for unknown element id " + elementId;
+		}
+
+		return path;
+	}
+
+	private _indexElementIds(rootNode: ADataJSON) {
+		this.elementIds.clear();
+		this.elementPaths.clear();
+
+		this._indexSubtreeElementIds(rootNode, []);
+	}
+
+	/**
+	 * Adds the element ids of the node and its children, placeholder groups are collected for loading them later.
+	 */
+	private _indexSubtreeElementIds(node: ADataJSON, parentPath: string[]) {
+		const path = node.type.toLowerCase() === 'root' ? parentPath : parentPath.concat(node.name);
+
+		if (node.id !== undefined) {
+			this.elementIds.set(path.toString(), node.id);
+			this.elementPaths.set(node.id, path);
+		}
+
+		const groupNode = <GroupDataJSON>node;
+
+		if (groupNode.lazy && path.length > 0) {
+			this.placeholders.set(path.toString(), groupNode);
+		}
+
+		if (groupNode.elements) {
+			groupNode.elements.forEach(child => this._indexSubtreeElementIds(child, path));
+		}
+	}
+
 	private _readDataValue(reader : NetworkBufferReader) : ValueWrapper {
-		const valueType = reader.extractUint8();
+		return this._readTypedDataValue(reader, reader.extractUint8());
+	}
 
+	private _readTypedDataValue(reader : NetworkBufferReader, valueType : number) : ValueWrapper {
 		switch (valueType) {
 			case ValueType.Int32: {
 				const numberValue : number = reader.extractInt32();
@@ -0,0 +1,49 @@
+const GUI_SCHEMA_CACHE_PREFIX = 'gui-schema-';
+
+interface CachedGUISchema {
+	hash: number;
+	schema: ADataJSON;
+}
+
+/**
+ * \returns the cached GUI description of the device, when it matches the given structure hash.
+ */
+function LoadCachedGUISchema(deviceKey: string, hash: number) : ADataJSON | null {
+	try {
+		const stored = window.localStorage.getItem(GUI_SCHEMA_CACHE_PREFIX + deviceKey);
+
+		if (!stored)
+			return null;
+
+		const entry = <CachedGUISchema>JSON.parse(stored);
+
+		if (entry.hash !== hash)
+			return null;
+
+		return entry.schema;
+	} catch (err) {
+		Log("Unable to load cached GUI description: " + err);
+		return null;
+	}
+}
+
+/**
+ * Stores the GUI description of the device, replaces an older entry of the same device.
+ */
+function StoreCachedGUISchema(deviceKey: string, hash: number, schema: ADataJSON) {
+	const entry : CachedGUISchema = {hash: hash, schema: schema};
+
+	try {
+		window.localStorage.setItem(GUI_SCHEMA_CACHE_PREFIX + deviceKey, JSON.stringify(entry));
+	} catch (err) {
+		Log("Unable to cache GUI description: " + err);
+	}
+}
+
+function RemoveCachedGUISchema(deviceKey: string) {
+	try {
+		window.localStorage.removeItem(GUI_SCHEMA_CACHE_PREFIX + deviceKey);
+	} catch (err) {
+		Log("Unable to remove cached GUI description: " + err);
+	}
+}
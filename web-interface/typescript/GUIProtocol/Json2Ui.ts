@@ -1,6 +1,7 @@
 interface ADataJSON {
 	type: string;
 	name: string;
+	id: number | undefined;
 	advanced: boolean | undefined;
 	readOnly: boolean | undefined;
 }
@@ -12,6 +13,8 @@ interface RootDataJSON extends ADataJSON {
 interface GroupDataJSON extends ADataJSON {
 	elements : ADataJSON[];
 	collapsed : undefined | boolean;
+	// Placeholder without elements, the subtree is loaded on demand
+	lazy : undefined | boolean;
 }
 
 interface NumberValueJSON extends ADataJSON {
@@ -18,6 +18,13 @@ class NetworkBufferReader {
 		return value;
 	}
 
+	extractUint16() : number {
+		this._checkRange(2);
+		const value = this.dataView.getUint16(this.offset, false);
+		this.offset += 2;
+		return value;
+	}
+
 	extractUint32() : number {
 		this._checkRange(4);
 		const value = this.dataView.getUint32(this.offset, false);
@@ -39,6 +46,37 @@ class NetworkBufferReader {
 		return value;
 	}
 
+	/**
+	 * Extracts a unsigned LEB128 encoded value (up to 32 bit).
+	 */
+	extractVarUint() : number {
+		let value = 0;
+		let shift = 0;
+
+		while (true) {
+			const byte = this.extractUint8();
+			value += (byte & 0x7F) * Math.pow(2, shift);
+
+			if ((byte & 0x80) === 0) {
+				return value;
+			}
+
+			shift += 7;
+
+			if (shift > 28) {
+				throw 'VarUint exceeds 32 bit';
+			}
+		}
+	}
+
+	/**
+	 * Extracts a zig-zag encoded signed value (0, -1, 1, -2, ...) from a LEB128 value.
+	 */
+	extractZigZagInt() : number {
+		const value = this.extractVarUint();
+		return (value % 2 === 0) ? value / 2 : -(value + 1) / 2;
+	}
+
 	extractData(length: number) : DataView {
 		this._checkRange(length);
 		const value = this.dataView.buffer.slice(this.offset, this.offset + length);
@@ -56,6 +94,15 @@ class NetworkBufferReader {
 		return DecodeUTF8String(strData);
 	}
 
+	/**
+	 * Extracts a string prefixed by a varuint length.
+	 */
+	extractVarString() : string {
+		const strLength = this.extractVarUint();
+		const strData = this.extractData(strLength);
+		return DecodeUTF8String(strData);
+	}
+
 	private _checkRange(readSize: number) {
 		if (readSize > this.getRemainingSize()) {
 			throw 'Buffer range exception';
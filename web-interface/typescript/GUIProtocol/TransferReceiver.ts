@@ -0,0 +1,187 @@
+// Time without a new segment before the missing rest of a transfer is requested again
+const TRANSFER_RESUME_TIMEOUT_MS = 2000;
+
+// Resume requests and restarts of one transfer before falling back to a plain request
+const TRANSFER_MAX_RETRIES = 5;
+
+let CRC32_TABLE : Uint32Array | undefined;
+
+/**
+ * \returns the CRC-32 (IEEE 802.3, as used by zlib) of the data.
+ */
+function ComputeCRC32(data: Uint8Array) : number {
+	if (!CRC32_TABLE) {
+		CRC32_TABLE = new Uint32Array(256);
+
+		for (let i = 0; i < 256; ++i) {
+			let crc = i;
+
+			for (let bit = 0; bit < 8; ++bit) {
+				crc = (crc & 1) ? (0xEDB88320 ^ (crc >>> 1)) : (crc >>> 1);
+			}
+
+			CRC32_TABLE[i] = crc;
+		}
+	}
+
+	let crc = 0xFFFFFFFF;
+
+	for (let i = 0; i < data.length; ++i) {
+		crc = CRC32_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >>> 8);
+	}
+
+	return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+/**
+ * Receives the TransferSegment packets of a reliable transfer (binary GUI description or values).
+ *
+ * The segments carry their offset, missing segments are requested again by a transfer from the first missing byte.
+ * The CRC of the whole data is checked on completion, the transfer is restarted when it does not match
+ * or the data was changed on the device in between (different CRC in the segments).
+ */
+class TransferReceiver {
+	requestType: GUIClientHeader;
+	// Sends the transfer request for the data from the offset, returns the request id
+	sendRequestFunction: (requestType: GUIClientHeader, offset: number) => number;
+	onCompleteFunction: (data: Uint8Array) => void;
+	onFailFunction: () => void;
+
+	// Only the segments of the latest request are accepted
+	requestId: number | undefined;
+	// Earlier requests of the transfer, their segments still in flight only show that the link is alive
+	replacedRequestIds: Set<number>;
+	buffer: Uint8Array | undefined;
+	crc: number;
+	receivedLength: number;
+	retries: number;
+	resumeTimer: number | undefined;
+
+	constructor(requestType: GUIClientHeader, sendRequestFunction: (requestType: GUIClientHeader, offset: number) => number,
+		onCompleteFunction: (data: Uint8Array) => void, onFailFunction: () => void) {
+		this.requestType = requestType;
+		this.sendRequestFunction = sendRequestFunction;
+		this.onCompleteFunction = onCompleteFunction;
+		this.onFailFunction = onFailFunction;
+		this.requestId = undefined;
+		this.replacedRequestIds = new Set();
+		this.buffer = undefined;
+		this.crc = 0;
+		this.receivedLength = 0;
+		this.retries = 0;
+		this.resumeTimer = undefined;
+	}
+
+	start() {
+		this._request();
+	}
+
+	/**
+	 * Stops the transfer, later segments are ignored.
+	 */
+	cancel() {
+		this.requestId = undefined;
+		this.replacedRequestIds.clear();
+
+		if (this.resumeTimer !== undefined) {
+			window.clearTimeout(this.resumeTimer);
+			this.resumeTimer = undefined;
+		}
+	}
+
+	/**
+	 * \returns false when the segment does not belong to this transfer.
+	 */
+	handleSegment(requestId: number, reader: NetworkBufferReader) : boolean {
+		if (this.requestId === undefined) {
+			return false;
+		}
+
+		if (this.replacedRequestIds.has(requestId)) {
+			// The rest of a replaced request is still drained, the segments of the latest request follow
+			this._startResumeTimer();
+			return true;
+		}
+
+		if (requestId !== this.requestId) {
+			return false;
+		}
+
+		const offset = reader.extractUint32();
+		const totalLength = reader.extractUint32();
+		const crc = reader.extractUint32();
+		const data = new Uint8Array(reader.extractRemainingData().buffer);
+
+		if (this.buffer === undefined || this.buffer.length !== totalLength || this.crc !== crc) {
+			if (this.buffer !== undefined) {
+				Log("Transferred data changed on the device, restarting transfer ...");
+				this.buffer = undefined;
+				this.receivedLength = 0;
+				this._retry();
+				return true;
+			}
+
+			this.buffer = new Uint8Array(totalLength);
+			this.crc = crc;
+		}
+
+		if (offset !== this.receivedLength || offset + data.length > totalLength) {
+			Log("Missing transfer segment at offset " + this.receivedLength + ", requesting the rest ...");
+			this._retry();
+			return true;
+		}
+
+		this.buffer.set(data, offset);
+		this.receivedLength += data.length;
+
+		if (this.receivedLength < totalLength) {
+			this._startResumeTimer();
+			return true;
+		}
+
+		this.cancel();
+
+		if (ComputeCRC32(this.buffer) !== crc) {
+			Log("Transfer checksum mismatch, restarting transfer ...");
+			this.buffer = undefined;
+			this.receivedLength = 0;
+			this._retry();
+			return true;
+		}
+
+		this.onCompleteFunction(this.buffer);
+		return true;
+	}
+
+	private _request() {
+		if (this.requestId !== undefined) {
+			this.replacedRequestIds.add(this.requestId);
+		}
+
+		this.requestId = this.sendRequestFunction(this.requestType, this.receivedLength);
+		this._startResumeTimer();
+	}
+
+	private _retry() {
+		if (++this.retries > TRANSFER_MAX_RETRIES) {
+			Log("Transfer failed after " + TRANSFER_MAX_RETRIES + " retries");
+			this.cancel();
+			this.onFailFunction();
+			return;
+		}
+
+		this._request();
+	}
+
+	private _startResumeTimer() {
+		if (this.resumeTimer !== undefined) {
+			window.clearTimeout(this.resumeTimer);
+		}
+
+		this.resumeTimer = window.setTimeout(() => {
+			this.resumeTimer = undefined;
+			Log("Transfer stalled at offset " + this.receivedLength + ", requesting the rest ...");
+			this._retry();
+		}, TRANSFER_RESUME_TIMEOUT_MS);
+	}
+}
@@ -11,6 +11,9 @@ abstract class AUIElement {
 
 	advanced: boolean = false;
 	readOnly: boolean = false;
+	hidden: boolean = false;
+	// Last state reported by onVisibilityChange()
+	contentVisible: boolean = true;
 
 	constructor(type: UIElementType, name: string, parent: UIGroupElement | null) {
 		this.type = type;
@@ -49,13 +52,8 @@ abstract class AUIElement {
 	setAdvanced(advanced: boolean) : void {
 		this.advanced = advanced;
 
-		if (advanced && !GetConfig_ShowAdvancedFields()) {
-			this.setHidden(true);
-		}
-
-		if (!advanced || GetConfig_ShowAdvancedFields()) {
-			this.setHidden(false);
-		}
+		this.setHidden(advanced && !GetConfig_ShowAdvancedFields());
+		this.updateContentVisibility();
 	}
 
 	/**
@@ -78,6 +76,8 @@ abstract class AUIElement {
 	}
 
 	setHidden(hidden: boolean) : void {
+		this.hidden = hidden;
+
 		let rootElement = this.getDomRootElement();
 
 		if (hidden) {
@@ -127,6 +127,34 @@ abstract class AUIElement {
 		}
 	}
 
+	/**
+	 * \returns false when the content of the element is not shown (hidden advanced field, collapsed group).
+	 */
+	isContentVisible() : boolean {
+		return !this.hidden;
+	}
+
+	/**
+	 * Calls onVisibilityChange() when the result of isContentVisible() changed.
+	 */
+	protected updateContentVisibility() {
+		const visible = this.isContentVisible();
+
+		if (visible !== this.contentVisible) {
+			this.contentVisible = visible;
+			this.onVisibilityChange(this, visible);
+		}
+	}
+
+	/**
+	 * Called when the content of the element is hidden or shown, see isContentVisible().
+	 */
+	onVisibilityChange(sourceElement: AUIElement, visible: boolean) {
+		if (this.parent) {
+			this.parent.onVisibilityChange(sourceElement, visible);
+		}
+	}
+
 	onConfigChanged() {
 		this.setAdvanced(this.advanced);
 	}
@@ -156,12 +156,18 @@ class UIGroupElement extends AUIElement {
 
 			this.btnCollapse.innerText = BTN_TEXT_HIDE;
 		}
+
+		this.updateContentVisibility();
 	}
 
 	isCollapsed() : boolean {
 		return this.contentDiv.style.visibility !== '';
 	}
 
+	override isContentVisible() : boolean {
+		return super.isContentVisible() && !this.isCollapsed();
+	}
+
 	private toggleContentVisibility() {
 		this.setCollapsed(!this.isCollapsed());
 	}
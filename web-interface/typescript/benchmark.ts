@@ -0,0 +1,138 @@
+/**
+ * Overlay page which measures the GUI link of a device: round trip times of pings,
+ * sustained throughput of a byte stream and the rate and loss of update packets.
+ */
+class BenchmarkPage {
+	guiControl: GUIProtocolHandler;
+	onCloseFunction: () => void;
+	overlay: HTMLDivElement;
+	buttonRun: HTMLButtonElement;
+	resultsElement: HTMLPreElement;
+
+	pingCountField: HTMLInputElement;
+	pingSizeField: HTMLInputElement;
+	streamLengthField: HTMLInputElement;
+	updateCountField: HTMLInputElement;
+	updateSizeField: HTMLInputElement;
+	updateIntervalField: HTMLInputElement;
+
+	constructor(deviceName: string, guiControl: GUIProtocolHandler, onCloseFunction: () => void) {
+		this.guiControl = guiControl;
+		this.onCloseFunction = onCloseFunction;
+
+		this.overlay = HTML.CreateDivElement('overlay');
+		const content = HTML.CreateDivElement('overlay-content');
+
+		const buttonClose = HTML.CreateButtonElement('×');
+		buttonClose.classList.add('close-btn');
+		buttonClose.onclick = () => {this.close();};
+
+		content.appendChild(buttonClose);
+		content.appendChild(HTML.CreateHElement(3, 'Benchmark ' + deviceName));
+
+		this.pingCountField = this._addNumberField(content, 'Pings', 100);
+		this.pingSizeField = this._addNumberField(content, 'Ping size (bytes)', 16);
+		this.streamLengthField = this._addNumberField(content, 'Stream length (bytes)', 65536);
+		this.updateCountField = this._addNumberField(content, 'Updates', 500);
+		this.updateSizeField = this._addNumberField(content, 'Update size (bytes)', 24);
+		this.updateIntervalField = this._addNumberField(content, 'Update interval (ms)', 0);
+
+		this.buttonRun = HTML.CreateButtonElement('Run');
+		this.buttonRun.onclick = () => {this._run();};
+		content.appendChild(this.buttonRun);
+
+		this.resultsElement = document.createElement('pre');
+		this.resultsElement.style.textAlign = 'left';
+		content.appendChild(this.resultsElement);
+
+		if (!guiControl.benchmarkSupported) {
+			this._print('The device does not support benchmarks');
+			this.buttonRun.disabled = true;
+		}
+
+		this.overlay.appendChild(content);
+		this.overlay.style.display = 'flex';
+		document.body.appendChild(this.overlay);
+	}
+
+	close() {
+		if (!this.overlay.parentNode) {
+			return;
+		}
+
+		this.guiControl.benchmark.cancel();
+		document.body.removeChild(this.overlay);
+		this.onCloseFunction();
+	}
+
+	private _addNumberField(parent: HTMLElement, title: string, value: number) : HTMLInputElement {
+		const label = HTML.CreateLabelElement();
+		const field = HTML.CreateNumberFieldElement(value);
+		field.min = '0';
+
+		label.appendChild(HTML.CreateSpanElement(title + ' '));
+		label.appendChild(field);
+		parent.appendChild(label);
+		parent.appendChild(HTML.CreateBrElement());
+
+		return field;
+	}
+
+	private _print(line: string) {
+		this.resultsElement.innerText += line + '\n';
+	}
+
+	/**
+	 * Runs the pings, the byte stream and the update stream one after another.
+	 */
+	private _run() {
+		const benchmark = this.guiControl.benchmark;
+
+		this.buttonRun.disabled = true;
+		this.resultsElement.innerText = '';
+		this._print('Running pings ...');
+
+		benchmark.runPings(Number(this.pingCountField.value), Number(this.pingSizeField.value), (pingResult) => {
+			this._printPingResult(pingResult);
+			this._print('Running byte stream ...');
+
+			benchmark.runByteStream(Number(this.streamLengthField.value), (streamResult) => {
+				this._printStreamResult(streamResult);
+				this._print('Running update stream ...');
+
+				benchmark.runUpdateStream(Number(this.updateCountField.value), Number(this.updateSizeField.value),
+					Number(this.updateIntervalField.value), (updateResult) => {
+					this._printUpdateResult(updateResult);
+					this.buttonRun.disabled = false;
+				});
+			});
+		});
+	}
+
+	private _printPingResult(result: BenchmarkResult) {
+		const percentile = (p: number) => {
+			const time = result.getRoundTripTimePercentile(p);
+			return (time !== undefined) ? time.toFixed(1) + ' ms' : '-';
+		};
+
+		this._print('Pings: ' + result.received + '/' + result.expected + ' echoed, '
+			+ BenchmarkPage._formatRatio(result.getLossRatio()) + ' lost');
+		this._print('  RTT p50 ' + percentile(50) + ', p90 ' + percentile(90) + ', p99 ' + percentile(99) + ', max ' + percentile(100));
+	}
+
+	private _printStreamResult(result: BenchmarkResult) {
+		this._print('Stream: ' + result.received + '/' + result.expected + ' bytes, '
+			+ BenchmarkPage._formatRatio(result.getLossRatio()) + ' lost');
+		this._print('  Sustained ' + (result.getThroughput() / 1024).toFixed(1) + ' kB/s over ' + result.durationMs.toFixed(0) + ' ms');
+	}
+
+	private _printUpdateResult(result: BenchmarkResult) {
+		this._print('Updates: ' + result.received + '/' + result.expected + ' received, '
+			+ BenchmarkPage._formatRatio(result.getLossRatio()) + ' lost');
+		this._print('  ' + result.getUpdateRate().toFixed(1) + ' updates/s, ' + (result.getThroughput() / 1024).toFixed(1) + ' kB/s');
+	}
+
+	private static _formatRatio(ratio: number) : string {
+		return (ratio * 100).toFixed(1) + '%';
+	}
+}